@@ -30,7 +30,12 @@ struct SimpleAudioDevice_IVars
 	OSSharedPtr<IOUserAudioDriver>	m_driver;
 	OSSharedPtr<IODispatchQueue>	m_work_queue;
 	
-	uint64_t	m_zts_host_ticks_per_buffer;
+	// The host time of zero timestamp N is
+	// m_zts_anchor_host_time + (N * m_zts_host_ticks_numerator) / m_zts_host_ticks_denominator.
+	uint64_t	m_zts_host_ticks_numerator;
+	uint64_t	m_zts_host_ticks_denominator;
+	uint64_t	m_zts_anchor_host_time;
+	uint64_t	m_zts_index;
 	
 	IOUserAudioStreamBasicDescription		m_stream_format;
 
@@ -462,10 +467,12 @@ kern_return_t SimpleAudioDevice::StartTimers()
 		/// - Tag: StartTimers
 		// Clear the device's timestamps.
 		UpdateCurrentZeroTimestamp(0, 0);
+		ivars->m_zts_anchor_host_time = 0;
+		ivars->m_zts_index = 0;
 		auto current_time = mach_absolute_time();
 
 		// Start the timer. The first timestamp occurs when the timer goes off.
-		ivars->m_zts_timer_event_source->WakeAtTime(kIOTimerClockMachAbsoluteTime, current_time + ivars->m_zts_host_ticks_per_buffer, 0);
+		ivars->m_zts_timer_event_source->WakeAtTime(kIOTimerClockMachAbsoluteTime, current_time + HostTicksForZeroTimestamps(1), 0);
 		ivars->m_zts_timer_event_source->SetEnable(true);
 	}
 	else
@@ -489,10 +496,25 @@ void	SimpleAudioDevice::UpdateTimers()
 	struct mach_timebase_info timebase_info;
 	mach_timebase_info(&timebase_info);
 	
-	double sample_rate = ivars->m_stream_format.mSampleRate;
-	double host_ticks_per_buffer = static_cast<double>(GetZeroTimestampPeriod() * NSEC_PER_SEC) / sample_rate;
-	host_ticks_per_buffer = (host_ticks_per_buffer * static_cast<double>(timebase_info.denom)) / static_cast<double>(timebase_info.numer);
-	ivars->m_zts_host_ticks_per_buffer = static_cast<uint64_t>(host_ticks_per_buffer);
+	// Keep the zero timestamp period as an exact ratio of host ticks instead of a truncated
+	// tick count, so rounding doesn't accumulate into drift. The sample rate is in millihertz
+	// to preserve fractional rates.
+	uint64_t sample_rate_millihertz = static_cast<uint64_t>(llround(ivars->m_stream_format.mSampleRate * 1000.0));
+	ivars->m_zts_host_ticks_numerator = static_cast<uint64_t>(GetZeroTimestampPeriod()) * NSEC_PER_SEC * 1000 * timebase_info.denom;
+	ivars->m_zts_host_ticks_denominator = sample_rate_millihertz * timebase_info.numer;
+}
+
+uint64_t	SimpleAudioDevice::HostTicksForZeroTimestamps(uint64_t in_count)
+{
+	// The product overflows 64 bits after a few hours of I/O, so do the math in 128 bits.
+	unsigned __int128 ticks = static_cast<unsigned __int128>(in_count) * ivars->m_zts_host_ticks_numerator;
+	return static_cast<uint64_t>(ticks / ivars->m_zts_host_ticks_denominator);
+}
+
+uint64_t	SimpleAudioDevice::ZeroTimestampsForHostTicks(uint64_t in_host_ticks)
+{
+	unsigned __int128 count = static_cast<unsigned __int128>(in_host_ticks) * ivars->m_zts_host_ticks_denominator;
+	return static_cast<uint64_t>(count / ivars->m_zts_host_ticks_numerator);
 }
 
 /// - Tag: ZtsTimerOccurred
@@ -501,31 +523,34 @@ void	SimpleAudioDevice::ZtsTimerOccurred_Impl(OSAction* action, uint64_t time)
 	// Get the current time.
 	auto current_time = time;
 	
-	// Increment the timestamps...
-	uint64_t current_sample_time = 0;
-	uint64_t current_host_time = 0;
-	GetCurrentZeroTimestamp(&current_sample_time, &current_host_time);
-	
-	auto host_ticks_per_buffer = ivars->m_zts_host_ticks_per_buffer;
-	
-	if(current_host_time != 0)
+	if(ivars->m_zts_anchor_host_time != 0)
 	{
-		current_sample_time += GetZeroTimestampPeriod();
-		current_host_time += host_ticks_per_buffer;
+		// Compute the timestamp from the anchor instead of adding one period to the previous
+		// timestamp. If the timer fired more than a period late, skip ahead to the period that
+		// contains the current time so the timestamps stay on the same timeline.
+		auto zts_index = ivars->m_zts_index + 1;
+		auto elapsed_count = ZeroTimestampsForHostTicks(current_time - ivars->m_zts_anchor_host_time);
+		if(elapsed_count > zts_index)
+		{
+			zts_index = elapsed_count;
+		}
+		ivars->m_zts_index = zts_index;
 	}
 	else
 	{
-		// ...but not if it's the first one.
-		current_sample_time = 0;
-		current_host_time = current_time;
+		// Anchor the timeline to the first timestamp.
+		ivars->m_zts_anchor_host_time = current_time;
+		ivars->m_zts_index = 0;
 	}
 	
 	// Update the device with the current timestamp.
+	uint64_t current_sample_time = ivars->m_zts_index * GetZeroTimestampPeriod();
+	uint64_t current_host_time = ivars->m_zts_anchor_host_time + HostTicksForZeroTimestamps(ivars->m_zts_index);
 	UpdateCurrentZeroTimestamp(current_sample_time, current_host_time);
 	
-	// Set the timer to go off in one buffer.
+	// Set the timer to go off at the start of the next period.
 	ivars->m_zts_timer_event_source->WakeAtTime(kIOTimerClockMachAbsoluteTime,
-												current_host_time + host_ticks_per_buffer, 0);
+												ivars->m_zts_anchor_host_time + HostTicksForZeroTimestamps(ivars->m_zts_index + 1), 0);
 }
 
 /// - Tag: GenerateToneForInput
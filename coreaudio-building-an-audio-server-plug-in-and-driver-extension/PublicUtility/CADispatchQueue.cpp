@@ -34,6 +34,7 @@ Core Audio Utilities
 CADispatchQueue::CADispatchQueue(const char* inName)
 :
 	mDispatchQueue(NULL),
+	mEventSourceMutex("CADispatchQueue::mEventSourceMutex"),
 	mPortDeathList(),
 	mMachPortReceiverList()
 {
@@ -44,6 +45,7 @@ CADispatchQueue::CADispatchQueue(const char* inName)
 CADispatchQueue::CADispatchQueue(CFStringRef inName)
 :
 	mDispatchQueue(NULL),
+	mEventSourceMutex("CADispatchQueue::mEventSourceMutex"),
 	mPortDeathList(),
 	mMachPortReceiverList()
 {
@@ -58,6 +60,7 @@ CADispatchQueue::CADispatchQueue(CFStringRef inName)
 CADispatchQueue::CADispatchQueue(CFStringRef inPattern, CFStringRef inName)
 :
 	mDispatchQueue(NULL),
+	mEventSourceMutex("CADispatchQueue::mEventSourceMutex"),
 	mPortDeathList(),
 	mMachPortReceiverList()
 {
@@ -243,20 +246,8 @@ void	CADispatchQueue::InstallMachPortDeathNotification(mach_port_t inMachPort, d
 {
 	ThrowIf(inMachPort == MACH_PORT_NULL, CAException('nope'), "CADispatchQueue::InstallMachPortDeathNotification: a mach port is required");
 	
-	//	 look in the list to see if we've already created an event source for it
-	bool wasFound = false;
-	EventSourceList::iterator theIterator = mPortDeathList.begin();
-	while(!wasFound && (theIterator != mPortDeathList.end()))
-	{
-		wasFound = theIterator->mMachPort == inMachPort;
-		if(!wasFound)
-		{
-			++theIterator;
-		}
-	}
-	
-	//	create and install the event source for the port
-	if(!wasFound)
+	//	 look in the map to see if we've already created an event source for it
+	if(!HasEventSource(mPortDeathList, inMachPort))
 	{
 		//	create an event source for the mach port
 		dispatch_source_t theDispatchSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_MACH_SEND, inMachPort, DISPATCH_MACH_SEND_DEAD, mDispatchQueue);
@@ -265,8 +256,13 @@ void	CADispatchQueue::InstallMachPortDeathNotification(mach_port_t inMachPort, d
 		//	install the event handler
 		dispatch_source_set_event_handler(theDispatchSource, inNotificationTask);
 		
-		//	put the info in the list
-		mPortDeathList.push_back(EventSource(theDispatchSource, inMachPort));
+		//	put the info in the map, unless another thread installed a source for the port in the meantime
+		//	in which case this source gets cancelled before it can handle any events
+		EventSource theEventSource(theDispatchSource, inMachPort);
+		if(!AddEventSource(mPortDeathList, theEventSource))
+		{
+			dispatch_source_cancel(theDispatchSource);
+		}
 		
 		//	resume the event source so that it can start handling messages and also so that the source can be released
 		dispatch_resume(theDispatchSource);
@@ -275,23 +271,10 @@ void	CADispatchQueue::InstallMachPortDeathNotification(mach_port_t inMachPort, d
 
 void	CADispatchQueue::RemoveMachPortDeathNotification(mach_port_t inMachPort)
 {
-	bool wasFound = false;
-	EventSourceList::iterator theIterator = mPortDeathList.begin();
-	while(!wasFound && (theIterator != mPortDeathList.end()))
-	{
-		wasFound = theIterator->mMachPort == inMachPort;
-		if(!wasFound)
-		{
-			++theIterator;
-		}
-	}
-	if(wasFound)
+	EventSource theEventSource(TakeEventSource(mPortDeathList, inMachPort));
+	if(theEventSource.mDispatchSource != NULL)
 	{
-		if(theIterator->mDispatchSource != NULL)
-		{
-			dispatch_source_cancel(theIterator->mDispatchSource);
-		}
-		mPortDeathList.erase(theIterator);
+		dispatch_source_cancel(theEventSource.mDispatchSource);
 	}
 }
 
@@ -299,20 +282,8 @@ void	CADispatchQueue::InstallMachPortReceiver(mach_port_t inMachPort, dispatch_b
 {
 	ThrowIf(inMachPort == MACH_PORT_NULL, CAException('nope'), "CADispatchQueue::InstallMachPortReceiver: a mach port is required");
 	
-	//	 look in the list to see if we've already created an event source for it
-	bool wasFound = false;
-	EventSourceList::iterator theIterator = mMachPortReceiverList.begin();
-	while(!wasFound && (theIterator != mMachPortReceiverList.end()))
-	{
-		wasFound = theIterator->mMachPort == inMachPort;
-		if(!wasFound)
-		{
-			++theIterator;
-		}
-	}
-	
-	//	create and install the event source for the port
-	if(!wasFound)
+	//	 look in the map to see if we've already created an event source for it
+	if(!HasEventSource(mMachPortReceiverList, inMachPort))
 	{
 		//	create an event source for the mach port
 		dispatch_source_t theDispatchSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_MACH_RECV, inMachPort, 0, mDispatchQueue);
@@ -321,8 +292,13 @@ void	CADispatchQueue::InstallMachPortReceiver(mach_port_t inMachPort, dispatch_b
 		//	install an event handler that maps the mach messages to the MIG server function
 		dispatch_source_set_event_handler(theDispatchSource, inMessageTask);
 		
-		//	put the info in the list
-		mMachPortReceiverList.push_back(EventSource(theDispatchSource, inMachPort));
+		//	put the info in the map, unless another thread installed a source for the port in the meantime
+		//	in which case this source gets cancelled before it can handle any messages
+		EventSource theEventSource(theDispatchSource, inMachPort);
+		if(!AddEventSource(mMachPortReceiverList, theEventSource))
+		{
+			dispatch_source_cancel(theDispatchSource);
+		}
 		
 		//	resume the event source so that it can start handling messages and also so that the source can be released
 		dispatch_resume(theDispatchSource);
@@ -331,31 +307,18 @@ void	CADispatchQueue::InstallMachPortReceiver(mach_port_t inMachPort, dispatch_b
 
 void	CADispatchQueue::RemoveMachPortReceiver(mach_port_t inMachPort, dispatch_block_t inCompletionTask)
 {
-	bool wasFound = false;
-	EventSourceList::iterator theIterator = mMachPortReceiverList.begin();
-	while(!wasFound && (theIterator != mMachPortReceiverList.end()))
+	EventSource theEventSource(TakeEventSource(mMachPortReceiverList, inMachPort));
+	if(theEventSource.mDispatchSource != NULL)
 	{
-		wasFound = theIterator->mMachPort == inMachPort;
-		if(!wasFound)
+		//	Set the cancel handler to the completion block. Note that the mach port cannot be freed
+		//	before the completion block runs due to a race condition. See the note in the comments
+		//	dispatch_source_set_cancel_handler in <dispatch/source.h>.
+		if(inCompletionTask != 0)
 		{
-			++theIterator;
+			dispatch_source_set_cancel_handler(theEventSource.mDispatchSource, inCompletionTask);
 		}
-	}
-	if(wasFound)
-	{
-		if(theIterator->mDispatchSource != NULL)
-		{
-			//	Set the cancel handler to the completion block. Note that the mach port cannot be freed
-			//	before the completion block runs due to a race condition. See the note in the comments
-			//	dispatch_source_set_cancel_handler in <dispatch/source.h>.
-			if(inCompletionTask != 0)
-			{
-				dispatch_source_set_cancel_handler(theIterator->mDispatchSource, inCompletionTask);
-			}
-		
-			dispatch_source_cancel(theIterator->mDispatchSource);
-		}
-		mMachPortReceiverList.erase(theIterator);
+	
+		dispatch_source_cancel(theEventSource.mDispatchSource);
 	}
 }
 
@@ -375,6 +338,40 @@ void	CADispatchQueue::RemoveMachPortReceiver(mach_port_t inMachPort, bool inDest
 										});
 }
 
+bool	CADispatchQueue::HasEventSource(const EventSourceMap& inEventSourceMap, mach_port_t inMachPort) const
+{
+	CAMutex::Locker theLocker(mEventSourceMutex);
+	return inEventSourceMap.find(inMachPort) != inEventSourceMap.end();
+}
+
+bool	CADispatchQueue::AddEventSource(EventSourceMap& inEventSourceMap, const EventSource& inEventSource)
+{
+	//	the map takes its own reference on the dispatch source, and returns false if the port already has one
+	CAMutex::Locker theLocker(mEventSourceMutex);
+	EventSource& theEventSource = inEventSourceMap[inEventSource.mMachPort];
+	if(theEventSource.mDispatchSource != NULL)
+	{
+		return false;
+	}
+	theEventSource = inEventSource;
+	return true;
+}
+
+CADispatchQueue::EventSource	CADispatchQueue::TakeEventSource(EventSourceMap& inEventSourceMap, mach_port_t inMachPort)
+{
+	//	remove the port's entry from the map and hand its reference to the caller, or return an empty
+	//	event source if the port isn't in the map
+	EventSource theAnswer;
+	CAMutex::Locker theLocker(mEventSourceMutex);
+	EventSourceMap::iterator theIterator = inEventSourceMap.find(inMachPort);
+	if(theIterator != inEventSourceMap.end())
+	{
+		theAnswer = theIterator->second;
+		inEventSourceMap.erase(theIterator);
+	}
+	return theAnswer;
+}
+
 CADispatchQueue&	CADispatchQueue::GetGlobalSerialQueue()
 {
 	dispatch_once_f(&sGlobalSerialQueueInitialized, NULL, InitializeGlobalSerialQueue);
@@ -14,13 +14,16 @@ Core Audio Utilities
 //	Includes
 //==================================================================================================
 
+//	PublicUtility Includes
+#include "CAMutex.h"
+
 //	System Includes
 #include <CoreFoundation/CFString.h>
 #include <dispatch/dispatch.h>
 
 //	Standard Library Includes
 #include <functional>
-#include <vector>
+#include <unordered_map>
 
 /*==================================================================================================
 	CADispatchQueue
@@ -119,11 +122,19 @@ protected:
 		void							Retain();
 		void							Release();
 	};
-	typedef std::vector<EventSource>	EventSourceList;
+	typedef std::unordered_map<mach_port_t, EventSource>	EventSourceMap;
+	
+	//	The event source maps are keyed by mach port so that installing and removing a source doesn't
+	//	have to search. mEventSourceMutex only guards the maps. Event sources are created and
+	//	cancelled outside of it.
+	bool								HasEventSource(const EventSourceMap& inEventSourceMap, mach_port_t inMachPort) const;
+	bool								AddEventSource(EventSourceMap& inEventSourceMap, const EventSource& inEventSource);
+	EventSource							TakeEventSource(EventSourceMap& inEventSourceMap, mach_port_t inMachPort);
 	
 	dispatch_queue_t					mDispatchQueue;
-	EventSourceList						mPortDeathList;
-	EventSourceList						mMachPortReceiverList;
+	CAMutex								mEventSourceMutex;
+	EventSourceMap						mPortDeathList;
+	EventSourceMap						mMachPortReceiverList;
 
 	static CADispatchQueue*				sGlobalSerialQueue;
 	static dispatch_once_t				sGlobalSerialQueueInitialized;
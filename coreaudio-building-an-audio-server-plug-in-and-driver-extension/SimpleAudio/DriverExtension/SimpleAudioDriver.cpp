@@ -116,7 +116,12 @@ struct SimpleAudioDriver_IVars
 	OSAction*					m_timer_occurred_action;
 	bool						m_is_running;
 	uint64_t					m_sample_rate;
-	uint64_t					m_host_ticks_per_buffer;
+
+	//	the host time of buffer N is m_anchor_host_time + (N * m_host_ticks_numerator) / m_host_ticks_denominator
+	uint64_t					m_host_ticks_numerator;
+	uint64_t					m_host_ticks_denominator;
+	uint64_t					m_anchor_host_time;
+	uint64_t					m_buffer_index;
 
 	uint32_t					m_master_input_volume;
 	uint32_t					m_master_output_volume;
@@ -433,7 +438,9 @@ kern_return_t SimpleAudioDriver::StartTimer()
 		ivars->m_status_buffer->mHostTime = 0;
 
 		//	start the timer, the first time stamp will be taken when it goes off
-		ivars->m_timer_event_source->WakeAtTime(kIOTimerClockMachAbsoluteTime, mach_absolute_time() + ivars->m_host_ticks_per_buffer, 0);
+		ivars->m_anchor_host_time = 0;
+		ivars->m_buffer_index = 0;
+		ivars->m_timer_event_source->WakeAtTime(kIOTimerClockMachAbsoluteTime, mach_absolute_time() + HostTicksForBuffers(1), 0);
 		ivars->m_timer_event_source->SetEnable(true);
 	}
 	else
@@ -458,10 +465,25 @@ void	SimpleAudioDriver::UpdateTimer()
 {
 	DebugMsg("");
 
+	//	keep the buffer period as an exact ratio of host ticks rather than a truncated tick count,
+	//	so that rounding doesn't accumulate into drift over long runs
 	struct mach_timebase_info timebase_info;
 	mach_timebase_info(&timebase_info);
-	ivars->m_host_ticks_per_buffer = (ivars->m_io_buffer_frame_size * 1000000000ULL) / ivars->m_sample_rate;
-	ivars->m_host_ticks_per_buffer = (ivars->m_host_ticks_per_buffer * timebase_info.denom) / timebase_info.numer;
+	ivars->m_host_ticks_numerator = ivars->m_io_buffer_frame_size * 1000000000ULL * timebase_info.denom;
+	ivars->m_host_ticks_denominator = ivars->m_sample_rate * timebase_info.numer;
+}
+
+uint64_t	SimpleAudioDriver::HostTicksForBuffers(uint64_t in_buffer_count)
+{
+	//	the product overflows 64 bits after a few hours of IO, so do the math in 128 bits
+	unsigned __int128 ticks = static_cast<unsigned __int128>(in_buffer_count) * ivars->m_host_ticks_numerator;
+	return static_cast<uint64_t>(ticks / ivars->m_host_ticks_denominator);
+}
+
+uint64_t	SimpleAudioDriver::BuffersForHostTicks(uint64_t in_host_ticks)
+{
+	unsigned __int128 buffers = static_cast<unsigned __int128>(in_host_ticks) * ivars->m_host_ticks_denominator;
+	return static_cast<uint64_t>(buffers / ivars->m_host_ticks_numerator);
 }
 
 void	SimpleAudioDriver::TimerOccurred_Impl(OSAction* action, uint64_t time)
@@ -478,20 +500,30 @@ void	SimpleAudioDriver::TimerOccurred_Impl(OSAction* action, uint64_t time)
 	auto current_time = mach_absolute_time();
 
 	//	increment the time stamps
-	if(ivars->m_status_buffer->mHostTime != 0)
+	if(ivars->m_anchor_host_time != 0)
 	{
-		ivars->m_status_buffer->mSampleTime += ivars->m_io_buffer_frame_size;
-		ivars->m_status_buffer->mHostTime += ivars->m_host_ticks_per_buffer;
+		//	compute the time stamps from the anchor instead of adding a buffer's worth of ticks to the
+		//	previous ones, and if the timer fired more than a buffer late, skip ahead to the buffer that
+		//	contains the current time so the time stamps stay on the same timeline
+		auto buffer_index = ivars->m_buffer_index + 1;
+		auto elapsed_buffers = BuffersForHostTicks(current_time - ivars->m_anchor_host_time);
+		if(elapsed_buffers > buffer_index)
+		{
+			buffer_index = elapsed_buffers;
+		}
+		ivars->m_buffer_index = buffer_index;
 	}
 	else
 	{
 		//	but not if it's the first one
-		ivars->m_status_buffer->mSampleTime = 0;
-		ivars->m_status_buffer->mHostTime = current_time;
+		ivars->m_anchor_host_time = current_time;
+		ivars->m_buffer_index = 0;
 	}
+	ivars->m_status_buffer->mSampleTime = ivars->m_buffer_index * ivars->m_io_buffer_frame_size;
+	ivars->m_status_buffer->mHostTime = ivars->m_anchor_host_time + HostTicksForBuffers(ivars->m_buffer_index);
 
-	//	set the timer to go off in one buffer
-	ivars->m_timer_event_source->WakeAtTime(kIOTimerClockMachAbsoluteTime, ivars->m_status_buffer->mHostTime + ivars->m_host_ticks_per_buffer, 0);
+	//	set the timer to go off at the start of the next buffer
+	ivars->m_timer_event_source->WakeAtTime(kIOTimerClockMachAbsoluteTime, ivars->m_anchor_host_time + HostTicksForBuffers(ivars->m_buffer_index + 1), 0);
 }
 
 kern_return_t	SimpleAudioDriver::GetVolume(uint32_t in_volume_id, uint32_t& out_volume)
@@ -13,6 +13,36 @@ Implements the service object that dispatches keyboard events to the system.
 
 #include "HIDKeyboardDriver.h"
 
+/* Keyboard usage bitmap
+ *
+ * Keyboard usages fit in a single byte, so the driver tracks the state of
+ *  every key as one bit in a 256-bit bitmap.
+ */
+#define kKeyboardUsageCount         256
+#define kKeyboardBitmapWordCount    (kKeyboardUsageCount / 64)
+
+typedef uint64_t KeyboardBitmap[kKeyboardBitmapWordCount];
+
+/* struct KeyboardReportEntry
+ *
+ * The range of keyboard elements in the key table that a report ID updates.
+ */
+struct KeyboardReportEntry
+{
+    uint32_t first;
+    uint32_t count;
+};
+
+/* struct KeyboardKeyEntry
+ *
+ * A keyboard element, and the usage it reports.
+ */
+struct KeyboardKeyEntry
+{
+    IOHIDElement    *element;
+    uint32_t        usage;
+};
+
 /* struct HIDKeyboardDriver_IVars
  *
  * This structure contains the instance variables for a HIDKeyboardDriver object.
@@ -22,7 +52,11 @@ struct HIDKeyboardDriver_IVars
     OSArray *elements;
     
     struct {
-        OSArray *elements;
+        OSArray                 *elements;
+        KeyboardKeyEntry        *keys;
+        uint32_t                keyCount;
+        KeyboardReportEntry     reports[kKeyboardUsageCount];
+        KeyboardBitmap          state;
     } keyboard;
 };
 
@@ -57,6 +91,7 @@ void HIDKeyboardDriver::free()
     if (ivars) {
         OSSafeReleaseNULL(_elements);
         OSSafeReleaseNULL(_keyboard.elements);
+        IOSafeDeleteNULL(_keyboard.keys, KeyboardKeyEntry, _keyboard.keyCount);
     }
     
     IOSafeDeleteNULL(ivars, HIDKeyboardDriver_IVars, 1);
@@ -135,9 +170,74 @@ bool HIDKeyboardDriver::parseElements(OSArray *elements)
         }
     }
     
+    if (result) {
+        result = buildKeyTable();
+    }
+    
     return result;
 }
 
+/* buildKeyTable
+ *
+ * This method sorts the saved keyboard elements by report ID into a flat
+ *  key table, so handleKeyboardReport reads only the elements that belong
+ *  to the incoming report. It also seeds the key state bitmap with the
+ *  elements' current values.
+ */
+/// - Tag: buildKeyTable
+bool HIDKeyboardDriver::buildKeyTable()
+{
+    uint32_t count = _keyboard.elements->getCount();
+    uint32_t next[kKeyboardUsageCount];
+    
+    if (!count) {
+        return false;
+    }
+    
+    _keyboard.keys = IONewZero(KeyboardKeyEntry, count);
+    if (!_keyboard.keys) {
+        return false;
+    }
+    
+    _keyboard.keyCount = count;
+    
+    // Count the elements in each report.
+    for (unsigned int i = 0; i < count; i++) {
+        IOHIDElement *element = OSDynamicCast(IOHIDElement, _keyboard.elements->getObject(i));
+        
+        if (element) {
+            _keyboard.reports[element->getReportID() & (kKeyboardUsageCount - 1)].count++;
+        }
+    }
+    
+    // Assign each report ID its range in the key table.
+    for (unsigned int reportID = 0, first = 0; reportID < kKeyboardUsageCount; reportID++) {
+        _keyboard.reports[reportID].first = first;
+        next[reportID] = first;
+        first += _keyboard.reports[reportID].count;
+    }
+    
+    // Fill the ranges, and record the current state of each key.
+    for (unsigned int i = 0; i < count; i++) {
+        IOHIDElement *element = OSDynamicCast(IOHIDElement, _keyboard.elements->getObject(i));
+        KeyboardKeyEntry *key = NULL;
+        
+        if (!element) {
+            continue;
+        }
+        
+        key = &_keyboard.keys[next[element->getReportID() & (kKeyboardUsageCount - 1)]++];
+        key->element = element;
+        key->usage = element->getUsage() & (kKeyboardUsageCount - 1);
+        
+        if (element->getValue(0)) {
+            _keyboard.state[key->usage / 64] |= (1ULL << (key->usage % 64));
+        }
+    }
+    
+    return true;
+}
+
 
 /* parseKeyboardElement
  *
@@ -198,57 +298,61 @@ void HIDKeyboardDriver::handleReport(uint64_t timestamp,
  *  By the time the driver calls this method, the parent class has already
  *  updated the IOHIDElement objects that you retrieved in your Start method.
  *  As a result, each element contains data from the most recent input report.
+ *  The method decodes the report's elements into a new key state bitmap, and
+ *  compares it against the previous bitmap to find the keys that changed.
  */
 /// - Tag: handleKeyboardReport
 void HIDKeyboardDriver::handleKeyboardReport(uint64_t timestamp,
                                              uint32_t reportID)
 {
-    if (!_keyboard.elements) {
+    KeyboardReportEntry *report = NULL;
+    KeyboardBitmap state;
+    
+    if (!_keyboard.keys || reportID >= kKeyboardUsageCount) {
         return;
     }
     
-    // Iterate over the elements that contain keyboard data.
-    for (unsigned int i = 0; i < _keyboard.elements->getCount(); i++) {
-        IOHIDElement *element = NULL;
-        uint64_t elementTimeStamp;
-        uint32_t usagePage, usage, value, preValue;
-        
-        element = OSDynamicCast(IOHIDElement, _keyboard.elements->getObject(i));
-        
-        if (!element) {
-            continue;
-        }
+    report = &_keyboard.reports[reportID];
+    memcpy(state, _keyboard.state, sizeof(state));
+    
+    // Decode the elements in the report into the new key state. Keys that
+    // the report doesn't contain keep their previous state.
+    for (unsigned int i = 0; i < report->count; i++) {
+        const KeyboardKeyEntry *key = &_keyboard.keys[report->first + i];
+        uint64_t mask = 1ULL << (key->usage % 64);
         
         // If the element doesn't contain new data, skip it.
-        if (element->getReportID() != reportID) {
+        if (key->element->getTimeStamp() != timestamp) {
             continue;
         }
         
-        elementTimeStamp = element->getTimeStamp();
-        if (timestamp != elementTimeStamp) {
-            continue;
+        if (key->element->getValue(0)) {
+            state[key->usage / 64] |= mask;
+        } else {
+            state[key->usage / 64] &= ~mask;
         }
+    }
+    
+    // Dispatch an event for each key whose state differs from the previous
+    // report.
+    for (unsigned int word = 0; word < kKeyboardBitmapWordCount; word++) {
+        uint64_t changed = state[word] ^ _keyboard.state[word];
         
-        // Get the previous value of the element.
-        preValue = element->getValue(kIOHIDValueOptionsFlagPrevious) != 0;
-        value = element->getValue(0) != 0;
-        
-        // If the element's value didn't change, skip it.
-        if (value == preValue) {
-            continue;
+        while (changed) {
+            uint32_t usage = (word * 64) + __builtin_ctzll(changed);
+            uint32_t value = (state[word] >> (usage % 64)) & 1;
+            
+            changed &= changed - 1;
+            
+            os_log(OS_LOG_DEFAULT,
+                   "Dispatching key with ussagPage: 0x%02x usage: 0x%02x value: %d",
+                   kHIDPage_KeyboardOrKeypad, usage, value);
+            dispatchKeyboardEvent(timestamp, kHIDPage_KeyboardOrKeypad, usage, value, 0, true);
         }
-        
-        // If the code reaches this point, the element has new data, so
-        //  dispatch an event with the new value to the system.
-        usagePage = element->getUsagePage();
-        usage = element->getUsage();
-        
-        os_log(OS_LOG_DEFAULT,
-               "Dispatching key with ussagPage: 0x%02x usage: 0x%02x value: %d",
-               usagePage, usage, value);
-        dispatchKeyboardEvent(timestamp, usagePage, usage, value, 0, true);
     }
     
+    memcpy(_keyboard.state, state, sizeof(state));
+    
 exit:
     return;
 }
@@ -13,6 +13,56 @@ Implements the service object that dispatches stylus events to the system.
 
 #include "HIDStylusDriver.h"
 
+// The stylus fields that a digitizer element can update. parseElements
+// resolves each element's usage page and usage to one of these values once,
+// so report handling doesn't need to switch on usages for every element.
+enum StylusField : uint8_t
+{
+    kStylusFieldX,
+    kStylusFieldY,
+    kStylusFieldIdentifier,
+    kStylusFieldTip,
+    kStylusFieldBarrelSwitch,
+    kStylusFieldEraser,
+    kStylusFieldInRange,
+    kStylusFieldBarrelPressure,
+    kStylusFieldTipPressure,
+    kStylusFieldTiltX,
+    kStylusFieldTiltY,
+    kStylusFieldTwist,
+    kStylusFieldInvert,
+};
+
+// A digitizer element, along with the values the driver needs to decode it
+// that don't change between reports.
+struct StylusElementEntry
+{
+    IOHIDElement    *element;
+    uint32_t        reportID;
+    int32_t         logicalMin;
+    uint32_t        logicalDiff;
+    StylusField     field;
+};
+
+// A digitizer collection and the packed list of its decodable elements.
+struct StylusCollectionEntry
+{
+    IOHIDDigitizerCollection    *collection;
+    StylusElementEntry          *elements;
+    uint32_t                    elementCount;
+    bool                        tipDown;
+};
+
+// HID report IDs are a single byte, so the dispatch table maps every possible
+// report ID directly to the range of collections that the report updates.
+#define kStylusReportIDCount 256
+
+struct StylusReportEntry
+{
+    uint16_t    first;
+    uint16_t    count;
+};
+
 struct HIDStylusDriver_IVars
 {
     OSArray *elements;
@@ -20,10 +70,22 @@ struct HIDStylusDriver_IVars
     struct {
         OSArray *collections;
     } digitizer;
+    
+    struct {
+        StylusCollectionEntry   *collections;
+        uint32_t                collectionCount;
+        StylusElementEntry      *elements;
+        uint32_t                elementCount;
+        uint32_t                elementCapacity;
+        uint16_t                *reportCollections;
+        uint32_t                reportCollectionCount;
+        StylusReportEntry       reports[kStylusReportIDCount];
+    } dispatch;
 };
 
 #define _elements   ivars->elements
 #define _digitizer  ivars->digitizer
+#define _dispatch   ivars->dispatch
 
 /* init()
 *
@@ -51,6 +113,7 @@ exit:
 void HIDStylusDriver::free()
 {
     if (ivars) {
+        freeDispatchTable();
         OSSafeReleaseNULL(_elements);
         OSSafeReleaseNULL(_digitizer.collections);
     }
@@ -130,9 +193,188 @@ bool HIDStylusDriver::parseElements(OSArray *elements)
         }
     }
     
+    if (result) {
+        result = buildDispatchTable();
+    }
+    
     return result;
 }
 
+/* stylusFieldForElement
+*
+* Maps the usage page and usage of a digitizer element to the stylus field
+*  it updates. Returns false if the driver doesn't decode the element.
+*/
+static bool stylusFieldForElement(IOHIDElement *element, StylusField *field)
+{
+    switch (element->getUsagePage()) {
+        case kHIDPage_GenericDesktop:
+            switch (element->getUsage()) {
+                case kHIDUsage_GD_X:                    *field = kStylusFieldX;                 return true;
+                case kHIDUsage_GD_Y:                    *field = kStylusFieldY;                 return true;
+            }
+            break;
+        case kHIDPage_Digitizer:
+            switch (element->getUsage()) {
+                case kHIDUsage_Dig_ContactIdentifier:   *field = kStylusFieldIdentifier;        return true;
+                case kHIDUsage_Dig_TipSwitch:           *field = kStylusFieldTip;               return true;
+                case kHIDUsage_Dig_BarrelSwitch:        *field = kStylusFieldBarrelSwitch;      return true;
+                case kHIDUsage_Dig_Eraser:              *field = kStylusFieldEraser;            return true;
+                case kHIDUsage_Dig_InRange:             *field = kStylusFieldInRange;           return true;
+                case kHIDUsage_Dig_BarrelPressure:      *field = kStylusFieldBarrelPressure;    return true;
+                case kHIDUsage_Dig_TipPressure:         *field = kStylusFieldTipPressure;       return true;
+                case kHIDUsage_Dig_XTilt:               *field = kStylusFieldTiltX;             return true;
+                case kHIDUsage_Dig_YTilt:               *field = kStylusFieldTiltY;             return true;
+                case kHIDUsage_Dig_Twist:               *field = kStylusFieldTwist;             return true;
+                case kHIDUsage_Dig_Invert:              *field = kStylusFieldInvert;            return true;
+            }
+            break;
+    }
+    
+    return false;
+}
+
+/* buildDispatchTable
+*
+* This method flattens the digitizer collections that parseDigitizerElement
+*  created into a dispatch table. Each collection gets a packed array of the
+*  elements it decodes, and each report ID maps directly to the collections
+*  that contain elements from that report. This lets handleDigitizerReport
+*  skip collections and elements that a report can't have changed.
+*/
+/// - Tag: buildDispatchTable
+bool HIDStylusDriver::buildDispatchTable()
+{
+    uint32_t collectionCount = _digitizer.collections->getCount();
+    uint32_t elementCount = 0;
+    uint32_t reportCollectionCount = 0;
+    uint32_t counts[kStylusReportIDCount] = { 0 };
+    
+    freeDispatchTable();
+    
+    if (!collectionCount || collectionCount > UINT16_MAX) {
+        return false;
+    }
+    
+    for (unsigned int i = 0; i < collectionCount; i++) {
+        IOHIDDigitizerCollection *collection = OSDynamicCast(IOHIDDigitizerCollection,
+                                                             _digitizer.collections->getObject(i));
+        OSArray *elements = collection ? collection->getElements() : NULL;
+        
+        if (elements) {
+            elementCount += elements->getCount();
+        }
+    }
+    
+    // Allocate at least one entry so an empty table still has valid storage.
+    elementCount = elementCount ? elementCount : 1;
+    
+    _dispatch.collections = IONewZero(StylusCollectionEntry, collectionCount);
+    _dispatch.collectionCount = collectionCount;
+    _dispatch.elements = IONewZero(StylusElementEntry, elementCount);
+    _dispatch.elementCapacity = elementCount;
+    
+    if (!_dispatch.collections || !_dispatch.elements) {
+        freeDispatchTable();
+        return false;
+    }
+    
+    // Pack each collection's decodable elements next to each other, and count
+    // the distinct report IDs that each collection depends on.
+    for (unsigned int i = 0; i < collectionCount; i++) {
+        IOHIDDigitizerCollection *collection = OSDynamicCast(IOHIDDigitizerCollection,
+                                                             _digitizer.collections->getObject(i));
+        StylusCollectionEntry *entry = &_dispatch.collections[i];
+        uint64_t seen[kStylusReportIDCount / 64] = { 0 };
+        OSArray *elements = NULL;
+        
+        entry->collection = collection;
+        entry->elements = &_dispatch.elements[_dispatch.elementCount];
+        
+        if (!collection || !(elements = collection->getElements())) {
+            continue;
+        }
+        
+        for (unsigned int j = 0; j < elements->getCount(); j++) {
+            IOHIDElement *element = OSDynamicCast(IOHIDElement, elements->getObject(j));
+            StylusElementEntry *elementEntry = &entry->elements[entry->elementCount];
+            StylusField field;
+            uint32_t reportID;
+            
+            if (!element || !stylusFieldForElement(element, &field)) {
+                continue;
+            }
+            
+            reportID = element->getReportID() & (kStylusReportIDCount - 1);
+            
+            elementEntry->element = element;
+            elementEntry->reportID = element->getReportID();
+            elementEntry->logicalMin = element->getLogicalMin();
+            elementEntry->logicalDiff = element->getLogicalMax() - element->getLogicalMin();
+            elementEntry->field = field;
+            entry->elementCount++;
+            
+            if (!(seen[reportID / 64] & (1ULL << (reportID % 64)))) {
+                seen[reportID / 64] |= (1ULL << (reportID % 64));
+                counts[reportID]++;
+                reportCollectionCount++;
+            }
+        }
+        
+        _dispatch.elementCount += entry->elementCount;
+    }
+    
+    reportCollectionCount = reportCollectionCount ? reportCollectionCount : 1;
+    
+    _dispatch.reportCollections = IONewZero(uint16_t, reportCollectionCount);
+    _dispatch.reportCollectionCount = reportCollectionCount;
+    
+    if (!_dispatch.reportCollections) {
+        freeDispatchTable();
+        return false;
+    }
+    
+    // Assign each report ID its range in the flat collection index list.
+    for (unsigned int reportID = 0, first = 0; reportID < kStylusReportIDCount; reportID++) {
+        _dispatch.reports[reportID].first = first;
+        first += counts[reportID];
+    }
+    
+    // Fill the ranges in collection order, so reports dispatch events in the
+    // same order as the collections array.
+    for (unsigned int i = 0; i < collectionCount; i++) {
+        StylusCollectionEntry *entry = &_dispatch.collections[i];
+        uint64_t seen[kStylusReportIDCount / 64] = { 0 };
+        
+        for (unsigned int j = 0; j < entry->elementCount; j++) {
+            uint32_t reportID = entry->elements[j].reportID & (kStylusReportIDCount - 1);
+            StylusReportEntry *report = &_dispatch.reports[reportID];
+            
+            if (seen[reportID / 64] & (1ULL << (reportID % 64))) {
+                continue;
+            }
+            
+            seen[reportID / 64] |= (1ULL << (reportID % 64));
+            _dispatch.reportCollections[report->first + report->count++] = i;
+        }
+    }
+    
+    return _dispatch.elementCount != 0;
+}
+
+/* freeDispatchTable
+*
+* Releases the memory that buildDispatchTable allocated.
+*/
+void HIDStylusDriver::freeDispatchTable()
+{
+    IOSafeDeleteNULL(_dispatch.collections, StylusCollectionEntry, _dispatch.collectionCount);
+    IOSafeDeleteNULL(_dispatch.elements, StylusElementEntry, _dispatch.elementCapacity);
+    IOSafeDeleteNULL(_dispatch.reportCollections, uint16_t, _dispatch.reportCollectionCount);
+    
+    memset(&_dispatch, 0, sizeof(_dispatch));
+}
+
 /* parseDigitizerElement
 *
 * This method examines the element to determine if it contains
@@ -283,36 +525,75 @@ static void printStylus(IOHIDDigitizerStylusData *data)
 *  By the time the driver calls this method, the parent class has already
 *  updated the IOHIDElement objects that you retrieved in your Start method.
 *  As a result, each element contains data from the most recent input report.
+*  The dispatch table limits the work to the collections that have elements
+*  in the report, plus any collection whose tip is still down.
 */
 /// - Tag: handleDigitizerReport
 void HIDStylusDriver::handleDigitizerReport(uint64_t timestamp,
                                            uint32_t reportID)
 {
-    if (!_digitizer.collections) {
+    StylusReportEntry *report = NULL;
+    const uint16_t *indexes = NULL;
+    
+    if (!_dispatch.collections) {
         return;
     }
     
-    for (unsigned int i = 0; i < _digitizer.collections->getCount(); i++) {
-        IOHIDDigitizerCollection *collection = OSDynamicCast(IOHIDDigitizerCollection,
-                                                             _digitizer.collections->getObject(i));
-        IOHIDDigitizerStylusData *stylusData = NULL;
+    report = &_dispatch.reports[reportID & (kStylusReportIDCount - 1)];
+    indexes = &_dispatch.reportCollections[report->first];
+    
+    for (unsigned int i = 0; i < report->count; i++) {
+        dispatchStylusDataForCollection(&_dispatch.collections[indexes[i]],
+                                        timestamp,
+                                        reportID);
+    }
+    
+    // A collection with its tip down reports its state on every report, even
+    // when the report doesn't contain any of its elements.
+    for (unsigned int i = 0; i < _dispatch.collectionCount; i++) {
+        StylusCollectionEntry *entry = &_dispatch.collections[i];
+        bool dispatched = false;
         
-        if (!collection) {
+        if (!entry->tipDown) {
             continue;
         }
         
-        stylusData = createStylusDataForDigitizerCollection(collection,
-                                                            timestamp,
-                                                            reportID);
+        for (unsigned int j = 0; j < report->count && !dispatched; j++) {
+            dispatched = (indexes[j] == i);
+        }
         
-        if (stylusData) {
-            printStylus(stylusData);
-            dispatchDigitizerStylusEvent(timestamp, stylusData);
-            IOFree(stylusData, sizeof(IOHIDDigitizerStylusData));
+        if (!dispatched) {
+            dispatchStylusDataForCollection(entry, timestamp, reportID);
         }
     }
 }
 
+/* dispatchStylusDataForCollection
+*
+* Creates the stylus data for a single dispatch table collection and, if
+*  the data changed, dispatches it to the system.
+*/
+void HIDStylusDriver::dispatchStylusDataForCollection(StylusCollectionEntry *entry,
+                                                      uint64_t timestamp,
+                                                      uint32_t reportID)
+{
+    IOHIDDigitizerStylusData *stylusData = NULL;
+    
+    if (!entry->collection) {
+        return;
+    }
+    
+    stylusData = createStylusDataForDigitizerCollection(entry,
+                                                        timestamp,
+                                                        reportID);
+    
+    if (stylusData) {
+        printStylus(stylusData);
+        dispatchDigitizerStylusEvent(timestamp, stylusData);
+        IOFree(stylusData, sizeof(IOHIDDigitizerStylusData));
+    }
+}
+
 /* createStylusDataForDigitizerCollection
 *
 * This method looks for updated data in the elements of the digitizer
@@ -322,117 +603,88 @@ void HIDStylusDriver::handleDigitizerReport(uint64_t timestamp,
 */
 /// - Tag: createStylusDataForDigitizerCollection
 IOHIDDigitizerStylusData *HIDStylusDriver::createStylusDataForDigitizerCollection(
-                                        IOHIDDigitizerCollection *collection,
+                                        StylusCollectionEntry *entry,
                                         uint64_t timestamp,
                                         uint32_t reportID)
 {
+    IOHIDDigitizerCollection *collection = entry->collection;
     IOHIDDigitizerStylusData *stylusData = NULL;
-    OSArray *elements = collection->getElements();
     bool handled = false;
     
-    if (!elements) {
-        return NULL;
-    }
-    
     stylusData = (IOHIDDigitizerStylusData *)IOMallocZero(sizeof(IOHIDDigitizerStylusData));
     
     if (!stylusData) {
         return NULL;
     }
     
-    // Iterate over all of the elements in the collection.
-    for (unsigned int i = 0; i < elements->getCount(); i++) {
-        IOHIDElement *element = OSDynamicCast(IOHIDElement, elements->getObject(i));
-        uint64_t elementTimeStamp;
-        uint32_t usagePage, usage, value, logicalDiff;
+    // Iterate over the packed elements of the collection. The dispatch table
+    // already resolved each element's usage to the stylus field it updates.
+    for (unsigned int i = 0; i < entry->elementCount; i++) {
+        const StylusElementEntry *elementEntry = &entry->elements[i];
+        IOHIDElement *element = elementEntry->element;
+        uint32_t value;
         bool elementIsCurrent;
         IOFixed scaledValue = 0;
         
-        if (!element) {
-            continue;
-        }
-        
         // Gather information from the element.
-        elementTimeStamp = element->getTimeStamp();
-        elementIsCurrent = (element->getReportID() == reportID) && (timestamp == elementTimeStamp);
-        usagePage = element->getUsagePage();
-        usage = element->getUsage();
+        elementIsCurrent = (elementEntry->reportID == reportID) && (timestamp == element->getTimeStamp());
         value = element->getValue(0);
-        logicalDiff = element->getLogicalMax() - element->getLogicalMin();
         
         // Compute the logical value for the current element, as needed.
-        if (logicalDiff) {
-            scaledValue = (IOFixed)(((value - element->getLogicalMin()) << 16) / logicalDiff);
+        if (elementEntry->logicalDiff) {
+            scaledValue = (IOFixed)(((value - elementEntry->logicalMin) << 16) / elementEntry->logicalDiff);
         }
         
         // Update the stylus data structure. Update the handled variable at
         // each step to indicate whether the data is new.
-        switch (usagePage) {
-            case kHIDPage_GenericDesktop:
-                switch (usage) {
-                    case kHIDUsage_GD_X:
-                        stylusData->x = scaledValue;
-                        handled |= elementIsCurrent;
-                        break;
-                    case kHIDUsage_GD_Y:
-                        stylusData->y = scaledValue;
-                        handled |= elementIsCurrent;
-                        break;
-                }
+        switch (elementEntry->field) {
+            case kStylusFieldX:
+                stylusData->x = scaledValue;
+                break;
+            case kStylusFieldY:
+                stylusData->y = scaledValue;
+                break;
+            case kStylusFieldIdentifier:
+                stylusData->identifier = value;
+                break;
+            case kStylusFieldTip:
+                stylusData->tip = value ? 1 : 0;
+                handled |= (stylusData->tip != 0);
+                break;
+            case kStylusFieldBarrelSwitch:
+                stylusData->barrelSwitch = value ? 1 : 0;
+                break;
+            case kStylusFieldEraser:
+                stylusData->eraser = value ? 1 : 0;
                 break;
-            case kHIDPage_Digitizer:
-                switch (usage) {
-                    case kHIDUsage_Dig_ContactIdentifier:
-                        stylusData->identifier = value;
-                        handled |= elementIsCurrent;
-                        break;
-                    case kHIDUsage_Dig_TipSwitch:
-                        stylusData->tip = value ? 1 : 0;
-                        handled |= (elementIsCurrent | (stylusData->tip != 0));
-                        break;
-                    case kHIDUsage_Dig_BarrelSwitch:
-                        stylusData->barrelSwitch = value ? 1 : 0;
-                        handled |= elementIsCurrent;
-                        break;
-                    case kHIDUsage_Dig_Eraser:
-                        stylusData->eraser = value ? 1 : 0;
-                        handled |= elementIsCurrent;
-                        break;
-                    case kHIDUsage_Dig_InRange:
-                        stylusData->inRange = value ? 1 : 0;
-                        handled |= elementIsCurrent;
-                        break;
-                    case kHIDUsage_Dig_BarrelPressure:
-                        stylusData->barrelPressure = scaledValue;
-                        handled |= elementIsCurrent;
-                        break;
-                    case kHIDUsage_Dig_TipPressure:
-                        stylusData->tipPressure = scaledValue;
-                        handled |= elementIsCurrent;
-                        break;
-                    case kHIDUsage_Dig_XTilt:
-                        stylusData->tiltX = element->getScaledFixedValue(kIOHIDValueScaleTypePhysical);
-                        handled |= elementIsCurrent;
-                        break;
-                    case kHIDUsage_Dig_YTilt:
-                        stylusData->tiltY = element->getScaledFixedValue(kIOHIDValueScaleTypePhysical);
-                        handled |= elementIsCurrent;
-                        break;
-                    case kHIDUsage_Dig_Twist:
-                        stylusData->twist = element->getScaledFixedValue(kIOHIDValueScaleTypePhysical);
-                        handled |= elementIsCurrent;
-                        break;
-                    case kHIDUsage_Dig_Invert:
-                        stylusData->invert = value ? 1 : 0;
-                        handled |= elementIsCurrent;
-                        break;
-                    default:
-                        break;
-                }
+            case kStylusFieldInRange:
+                stylusData->inRange = value ? 1 : 0;
+                break;
+            case kStylusFieldBarrelPressure:
+                stylusData->barrelPressure = scaledValue;
+                break;
+            case kStylusFieldTipPressure:
+                stylusData->tipPressure = scaledValue;
+                break;
+            case kStylusFieldTiltX:
+                stylusData->tiltX = element->getScaledFixedValue(kIOHIDValueScaleTypePhysical);
+                break;
+            case kStylusFieldTiltY:
+                stylusData->tiltY = element->getScaledFixedValue(kIOHIDValueScaleTypePhysical);
+                break;
+            case kStylusFieldTwist:
+                stylusData->twist = element->getScaledFixedValue(kIOHIDValueScaleTypePhysical);
+                break;
+            case kStylusFieldInvert:
+                stylusData->invert = value ? 1 : 0;
                 break;
         }
+        
+        handled |= elementIsCurrent;
     }
     
+    entry->tipDown = (stylusData->tip != 0);
+    
     // If no data changed, return NULL.
     if (!handled) {
         IOFree(stylusData, sizeof(IOHIDDigitizerStylusData));
@@ -162,54 +162,68 @@ static const NSUInteger kMaxFramesInFlight = 3;
 #endif
 }
 
-// Create and compact an acceleration structure, given an acceleration structure descriptor.
-- (id <MTLAccelerationStructure>)newAccelerationStructureWithDescriptor:(MTLAccelerationStructureDescriptor *)descriptor
+// Create and compact a set of acceleration structures, given their acceleration structure
+// descriptors. The sample encodes all of the builds into a single command buffer so that
+// it only needs one CPU/GPU synchronization point to read back the compacted sizes,
+// regardless of how many pieces of geometry the scene contains.
+- (NSArray <id <MTLAccelerationStructure>> *)newAccelerationStructuresWithDescriptors:(NSArray <MTLAccelerationStructureDescriptor *> *)descriptors
 {
-    // Query for the sizes needed to store and build the acceleration structure.
-    MTLAccelerationStructureSizes accelSizes = [_device accelerationStructureSizesWithDescriptor:descriptor];
+    NSUInteger count = descriptors.count;
 
-    // Allocate an acceleration structure large enough for this descriptor. This doesn't actually
-    // build the acceleration structure, it just allocates memory.
-    id <MTLAccelerationStructure> accelerationStructure = [_device newAccelerationStructureWithSize:accelSizes.accelerationStructureSize];
+    NSMutableArray <id <MTLAccelerationStructure>> *accelerationStructures = [[NSMutableArray alloc] initWithCapacity:count];
 
-    // Allocate scratch space Metal uses to build the acceleration structure.
-    // Use MTLResourceStorageModePrivate for best performance because the sample
-    // doesn't need access to the buffer's contents.
-    id <MTLBuffer> scratchBuffer = [_device newBufferWithLength:accelSizes.buildScratchBufferSize options:MTLResourceStorageModePrivate];
+    // Allocate a buffer for Metal to write each compacted accelerated structure's size into.
+    id <MTLBuffer> compactedSizeBuffer = [_device newBufferWithLength:sizeof(uint32_t) * count options:MTLResourceStorageModeShared];
 
-    // Create a command buffer to perform the acceleration structure build.
+    // Create a command buffer to perform all of the acceleration structure builds.
     id <MTLCommandBuffer> commandBuffer = [_queue commandBuffer];
 
     // Create an acceleration structure command encoder.
     id <MTLAccelerationStructureCommandEncoder> commandEncoder = [commandBuffer accelerationStructureCommandEncoder];
 
-    // Allocate a buffer for Metal to write the compacted accelerated structure's size into.
-    id <MTLBuffer> compactedSizeBuffer = [_device newBufferWithLength:sizeof(uint32_t) options:MTLResourceStorageModeShared];
-
-    // Schedule the actual acceleration structure build.
-    [commandEncoder buildAccelerationStructure:accelerationStructure
-                                    descriptor:descriptor
-                                 scratchBuffer:scratchBuffer
-                           scratchBufferOffset:0];
-
-    // Compute and write the compacted acceleration structure size into the buffer. You
-    // need to already have a built accelerated structure because Metal determines the compacted
-    // size based on the final size of the acceleration structure. Compacting an acceleration
-    // structure can potentially reclaim significant amounts of memory because Metal must
-    // create the initial structure using a conservative approach.
-
-    [commandEncoder writeCompactedAccelerationStructureSize:accelerationStructure
-                                                   toBuffer:compactedSizeBuffer
-                                                     offset:0];
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        MTLAccelerationStructureDescriptor *descriptor = descriptors[i];
+
+        // Query for the sizes needed to store and build the acceleration structure.
+        MTLAccelerationStructureSizes accelSizes = [_device accelerationStructureSizesWithDescriptor:descriptor];
+
+        // Allocate an acceleration structure large enough for this descriptor. This doesn't actually
+        // build the acceleration structure, it just allocates memory.
+        id <MTLAccelerationStructure> accelerationStructure = [_device newAccelerationStructureWithSize:accelSizes.accelerationStructureSize];
+
+        // Allocate scratch space Metal uses to build the acceleration structure.
+        // Use MTLResourceStorageModePrivate for best performance because the sample
+        // doesn't need access to the buffer's contents. Each build gets its own scratch
+        // buffer so that Metal can run the builds in the encoder concurrently.
+        id <MTLBuffer> scratchBuffer = [_device newBufferWithLength:accelSizes.buildScratchBufferSize options:MTLResourceStorageModePrivate];
+
+        // Schedule the actual acceleration structure build.
+        [commandEncoder buildAccelerationStructure:accelerationStructure
+                                        descriptor:descriptor
+                                     scratchBuffer:scratchBuffer
+                               scratchBufferOffset:0];
+
+        // Compute and write the compacted acceleration structure size into the buffer. You
+        // need to already have a built accelerated structure because Metal determines the compacted
+        // size based on the final size of the acceleration structure. Compacting an acceleration
+        // structure can potentially reclaim significant amounts of memory because Metal must
+        // create the initial structure using a conservative approach.
+        [commandEncoder writeCompactedAccelerationStructureSize:accelerationStructure
+                                                       toBuffer:compactedSizeBuffer
+                                                         offset:sizeof(uint32_t) * i];
+
+        [accelerationStructures addObject:accelerationStructure];
+    }
 
     // End encoding and commit the command buffer so the GPU can start building the
-    // acceleration structure.
+    // acceleration structures.
     [commandEncoder endEncoding];
 
     [commandBuffer commit];
 
     // The sample waits for Metal to finish executing the command buffer so that it can
-    // read back the compacted size.
+    // read back the compacted sizes.
 
     // Note: Don't wait for Metal to finish executing the command buffer if you aren't compacting
     // the acceleration structure because doing so requires CPU/GPU synchronization. You don't have
@@ -219,30 +233,43 @@ static const NSUInteger kMaxFramesInFlight = 3;
 
     [commandBuffer waitUntilCompleted];
 
-    uint32_t compactedSize = *(uint32_t *)compactedSizeBuffer.contents;
+    const uint32_t *compactedSizes = (const uint32_t *)compactedSizeBuffer.contents;
 
-    // Allocate a smaller acceleration structure based on the returned size.
-    id <MTLAccelerationStructure> compactedAccelerationStructure = [_device newAccelerationStructureWithSize:compactedSize];
+    NSMutableArray <id <MTLAccelerationStructure>> *compactedAccelerationStructures = [[NSMutableArray alloc] initWithCapacity:count];
 
     // Create another command buffer and encoder.
     commandBuffer = [_queue commandBuffer];
 
     commandEncoder = [commandBuffer accelerationStructureCommandEncoder];
 
-    // Encode the command to copy and compact the acceleration structure into the
-    // smaller acceleration structure.
-    [commandEncoder copyAndCompactAccelerationStructure:accelerationStructure
-                                toAccelerationStructure:compactedAccelerationStructure];
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        // Allocate a smaller acceleration structure based on the returned size.
+        id <MTLAccelerationStructure> compactedAccelerationStructure = [_device newAccelerationStructureWithSize:compactedSizes[i]];
+
+        // Encode the command to copy and compact the acceleration structure into the
+        // smaller acceleration structure.
+        [commandEncoder copyAndCompactAccelerationStructure:accelerationStructures[i]
+                                    toAccelerationStructure:compactedAccelerationStructure];
+
+        [compactedAccelerationStructures addObject:compactedAccelerationStructure];
+    }
 
     // End encoding and commit the command buffer. You don't need to wait for Metal to finish
     // executing this command buffer as long as you synchronize any ray-intersection work
     // to run after this command buffer completes. The sample relies on Metal's default
     // dependency tracking on resources to automatically synchronize access to the new
-    // compacted acceleration structure.
+    // compacted acceleration structures.
     [commandEncoder endEncoding];
     [commandBuffer commit];
 
-    return compactedAccelerationStructure;
+    return compactedAccelerationStructures;
+}
+
+// Create and compact an acceleration structure, given an acceleration structure descriptor.
+- (id <MTLAccelerationStructure>)newAccelerationStructureWithDescriptor:(MTLAccelerationStructureDescriptor *)descriptor
+{
+    return [self newAccelerationStructuresWithDescriptors:@[ descriptor ]].firstObject;
 }
 
 // Create acceleration structures for the scene. The scene contains primitive acceleration
@@ -254,22 +281,20 @@ static const NSUInteger kMaxFramesInFlight = 3;
 {
     MTLResourceOptions options = getManagedBufferStorageMode();
 
-    _primitiveAccelerationStructures = [[NSMutableArray alloc] init];
+    NSMutableArray <MTLAccelerationStructureDescriptor *> *primitiveDescriptors = [[NSMutableArray alloc] initWithCapacity:_scene.geometries.count];
 
-    // Create a primitive acceleration structure for each piece of geometry in the scene.
+    // Describe a primitive acceleration structure for each piece of geometry in the scene.
     for (NSUInteger i = 0; i < _scene.geometries.count; i++)
     {
         Geometry *mesh = _scene.geometries[i];
 
-        MTLPrimitiveAccelerationStructureDescriptor *accelDescriptor = [mesh accelerationStructureDescriptor];
-
-        // Build the acceleration structure.
-        id <MTLAccelerationStructure> accelerationStructure = [self newAccelerationStructureWithDescriptor:accelDescriptor];
-
-        // Add the acceleration structure to the array of primitive acceleration structures.
-        [_primitiveAccelerationStructures addObject:accelerationStructure];
+        [primitiveDescriptors addObject:[mesh accelerationStructureDescriptor]];
     }
 
+    // Build all of the primitive acceleration structures together, in the same order as the
+    // scene's geometries so that the instance descriptors can index them.
+    _primitiveAccelerationStructures = [[self newAccelerationStructuresWithDescriptors:primitiveDescriptors] mutableCopy];
+
     // Allocate a buffer of acceleration structure motion instance descriptors. Each descriptor
     // represents an instance of one of the primitive acceleration structures created above, with
     // its own set of transformation matrices representing where to place the instance in the scene
@@ -81,6 +81,10 @@ float3 getTriangleNormal(float3 v0, float3 v1, float3 v2)
 
 - (void)uploadToBuffers
 {
+    // Several geometries can share a keyframe, so only upload its data once.
+    if (_vertexPositionBuffer)
+        return;
+
     MTLResourceOptions options = getManagedBufferStorageMode();
 
     _vertexPositionBuffer = [_device newBufferWithLength:_vertices.size() * sizeof(vector_float3) options:options];
@@ -228,6 +232,17 @@ float3 getTriangleNormal(float3 v0, float3 v1, float3 v2)
     
     MeshVertex *meshVertices = (MeshVertex *)mesh.vertexBuffers[0].map.bytes;
     
+    // Reserve space for the de-indexed vertices up front to avoid repeatedly
+    // reallocating the vertex data while copying large models.
+    NSUInteger vertexCount = _vertices.size();
+    
+    for (MDLSubmesh *submesh in mesh.submeshes)
+        vertexCount += submesh.indexCount;
+    
+    _vertices.reserve(vertexCount);
+    _normals.reserve(vertexCount);
+    _colors.reserve(vertexCount);
+    
     for (MDLSubmesh *submesh in mesh.submeshes) {
         uint32_t *indices = (uint32_t *)submesh.indexBuffer.map.bytes;
         
@@ -567,8 +582,10 @@ float3 getTriangleNormal(float3 v0, float3 v1, float3 v2)
     if(usePrimitiveMotion)
     {
         // Create two keyframes of triangle data for the Ninja character the renderer
-        // animates using primitive motion.
-        TriangleKeyframeData *animatedNinjaKeyframe0Data = [[TriangleKeyframeData alloc] initWithDevice:device];
+        // animates using primitive motion. The first keyframe is the same model as the
+        // static Ninja, so share its keyframe data instead of loading and uploading the
+        // model a second time.
+        TriangleKeyframeData *animatedNinjaKeyframe0Data = staticNinjaKeyframeData;
         TriangleKeyframeData *animatedNinjaKeyframe1Data = [[TriangleKeyframeData alloc] initWithDevice:device];
 
         // Create a `Geometry` with two triangle keyframes.
@@ -578,9 +595,6 @@ float3 getTriangleNormal(float3 v0, float3 v1, float3 v2)
 
         [scene addGeometry:animatedNinjaGeometry];
 
-        // Load one model into the first keyframe.
-        [animatedNinjaKeyframe0Data addGeometryWithURL:URL];
-
         // Load a second model into the second keyframe. Metal interpolates between these two models.
         URL = [[NSBundle mainBundle] URLForResource:@"ninja_1" withExtension:@"obj"];
 
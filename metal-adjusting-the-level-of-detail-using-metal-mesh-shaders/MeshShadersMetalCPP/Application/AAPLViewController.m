@@ -63,7 +63,8 @@ The cross-platform view controller.
     _renderer = [[AAPLRendererAdapter alloc] initWithMtkView:_view];
     NSAssert(_renderer, @"Renderer failed initialization");
 
-    [_renderer drawableSizeWillChange:_view.bounds.size];
+    // Pass the size in pixels, because the renderer converts LOD error to pixels.
+    [_renderer drawableSizeWillChange:_view.drawableSize];
 
     // Configure the view to use this class instance to handle the draw and resize events.
     _view.delegate = self;
@@ -71,7 +72,7 @@ The cross-platform view controller.
 
 - (void)mtkView:(MTKView *)view drawableSizeWillChange:(CGSize)size
 {
-    [_renderer drawableSizeWillChange:_view.bounds.size];
+    [_renderer drawableSizeWillChange:size];
 }
 
 - (void)drawInMTKView:(nonnull MTKView *)view
@@ -6,6 +6,7 @@ The renderer's mesh shader implementation that draws bicubic Bezier patches.
 */
 
 #include <MetalKit/MetalKit.hpp>
+#include <dispatch/dispatch.h>
 #include <simd/simd.h>
 #include <vector>
 
@@ -71,92 +72,156 @@ matrix_float4x4 matrix_perspective_right_hand(float fovyRadians, float aspect, f
     );
 }
 
-/// Calculates the Berstein basis function with index 3, and subindex i.
-float bernsteinBasisCubic(float u, int i)
+/// Returns the four cubic Bernstein basis functions at u.
+simd_float4 bernsteinBasisCubic(float u)
 {
-    constexpr float n_choose_i[4] = {1, 3, 3, 1};
-    return n_choose_i[i] * powf(u, float(i)) * powf(1.0f - u, float(3 - i));
+    const float s = 1.0f - u;
+    return simd_make_float4(s * s * s, 3.0f * u * s * s, 3.0f * u * u * s, u * u * u);
 }
 
-/// Returns the bicubic patch point where k contains 16 elements.
-simd_float4 bicubicPoint(float u, float v, std::vector<simd_float3> controlPoints)
+/// Returns the derivatives of the four cubic Bernstein basis functions at u.
+simd_float4 bernsteinDerivativeCubic(float u)
 {
-    simd_float3 p = simd_make_float3(0, 0, 0);
-    int k = 0;
-    for (int i = 0; i <= 3; i++) {
-        for (int j = 0; j <= 3; j++) {
-            float Bni_u = bernsteinBasisCubic(u, i);
-            float Bmj_v = bernsteinBasisCubic(v, j);
-            p += Bni_u * Bmj_v * controlPoints[k];
-            k++;
-        }
+    const float s = 1.0f - u;
+    return simd_make_float4(-3.0f * s * s, 3.0f * s * (s - 2.0f * u), 3.0f * u * (2.0f * s - u), 3.0f * u * u);
+}
+
+/// The Bernstein basis and derivative values at each sample along one axis of a tessellated patch.
+struct AAPLBernsteinTable
+{
+    size_t segments;
+    std::vector<simd_float4> basis;
+    std::vector<simd_float4> derivative;
+};
+
+/// Precomputes the basis tables for a patch axis with the given number of samples.
+AAPLBernsteinTable makeBernsteinTable(size_t segments)
+{
+    AAPLBernsteinTable table;
+    table.segments = segments;
+    table.basis.resize(segments);
+    table.derivative.resize(segments);
+    for (size_t i = 0; i < segments; i++)
+    {
+        float u = i / float(segments - 1);
+        table.basis[i] = bernsteinBasisCubic(u);
+        table.derivative[i] = bernsteinDerivativeCubic(u);
     }
-    return simd_make_float4(p.x, p.y, p.z, 1.0f);
+    return table;
 }
 
-/// Returns a point on a bicubic patch.
+/// The 16 control points of a bicubic patch.
 ///
-/// The bicubic patch point is in parametric coordinates (u, v).
-simd_float4 bicubicPatch(int shape, float u, float v)
+/// Column j of `rows[i]` holds the control point that the u basis function i and the v basis function j weight.
+struct AAPLBicubicPatch
 {
-    static int gshape = -1;
-    static std::vector<simd_float3> controlPoints;
-    if (gshape != shape)
+    simd_float4x3 rows[4];
+};
+
+/// Generates the control points for a bicubic patch with a random height field.
+AAPLBicubicPatch makeBicubicPatch()
+{
+    AAPLBicubicPatch patch;
+    for (int i = 0; i < 4; i++)
     {
-        // Generate control points if this object wasn't used before.
-        controlPoints.resize(16);
-        int k = 0;
-        for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
         {
-            for (int j = 0; j < 4; j++)
-            {
-                controlPoints[k].x = i / 3.0f - 0.5f;
-                controlPoints[k].y = j / 3.0f - 0.5f;
-                controlPoints[k].z = -0.5 + 0.5 * drand48();
-                k++;
-            }
+            patch.rows[i].columns[j] = simd_make_float3(i / 3.0f - 0.5f,
+                                                        j / 3.0f - 0.5f,
+                                                        -0.5 + 0.5 * drand48());
         }
-        gshape = shape;
     }
-    return bicubicPoint(u, v, controlPoints);
+    return patch;
 }
 
-/// Returns a point on a bicubic patch with coordinates (u, v) for one of the bicubic patches.
-simd_float3 bicubicPatch3(int shape, float u, float v)
-{
-    simd_float4 p = bicubicPatch(shape, u, v);
-    return simd_make_float3(p.x, p.y, p.z);
-}
-
-/// Calculates the vertex data for a bicubic patch and returns the number of vertices the method adds to the array.
-size_t makePatchVertices(int shape, size_t segmentsX, size_t segmentsY, std::vector<AAPLVertex>& vertices)
+/// Calculates the vertex data for a bicubic patch into the given array and returns the number of vertices the method writes.
+///
+/// The method evaluates each row of the patch once for all the samples along u, and computes the normal from the
+/// cross product of the analytic partial derivatives of the patch.
+size_t makePatchVertices(const AAPLBicubicPatch& patch,
+                         const AAPLBernsteinTable& uTable,
+                         const AAPLBernsteinTable& vTable,
+                         AAPLVertex* vertices)
 {
-    // Resize the vertex array and check that it meets the size limitations.
-    size_t vertexCount = segmentsX * segmentsY;
+    const size_t segmentsX = uTable.segments;
+    const size_t segmentsY = vTable.segments;
 
     for (size_t j = 0; j < segmentsY; j++)
     {
+        // Collapse the patch along v to a cubic curve in u, and to the curve's derivative in v.
+        simd_float4x3 curve;
+        simd_float4x3 curveDv;
+        for (int k = 0; k < 4; k++)
+        {
+            curve.columns[k] = simd_mul(patch.rows[k], vTable.basis[j]);
+            curveDv.columns[k] = simd_mul(patch.rows[k], vTable.derivative[j]);
+        }
+
         for (size_t i = 0; i < segmentsX; i++)
         {
-            AAPLVertex vtx;
-            float u = i / float(segmentsX - 1);
-            float v = j / float(segmentsY - 1);
-            vtx.position = bicubicPatch(shape, u, v);
-            simd_float3 u1 = bicubicPatch3(shape, u - 0.01f, v);
-            simd_float3 u2 = bicubicPatch3(shape, u + 0.01f, v);
-            simd_float3 v1 = bicubicPatch3(shape, u, v - 0.01f);
-            simd_float3 v2 = bicubicPatch3(shape, u, v + 0.01f);
-            simd_float3 du = u2 - u1;
-            simd_float3 dv = v2 - v1;
+            AAPLVertex& vtx = vertices[j * segmentsX + i];
+            simd_float3 p = simd_mul(curve, uTable.basis[i]);
+            simd_float3 du = simd_mul(curve, uTable.derivative[i]);
+            simd_float3 dv = simd_mul(curveDv, uTable.basis[i]);
             simd_float3 N = simd_normalize(simd_cross(du, dv));
+            vtx.position = simd_make_float4(p.x, p.y, p.z, 1.0f);
             vtx.normal = simd_make_float4(N.x, N.y, N.z, 0);
             vtx.uv = simd_make_float2(i / float(segmentsX), j / float(segmentsY));
-            
-            vertices.push_back(vtx);
         }
     }
-    
-    return vertexCount;
+
+    return segmentsX * segmentsY;
+}
+
+static_assert(AAPLMaxMeshletVertexCount <= 256, "Meshlet vertices must be addressable with 8-bit local indices.");
+
+/// Returns a sphere that bounds the vertices, with the radius in the `w` component.
+simd_float4 makeBoundingSphere(const AAPLVertex* vertices, size_t count)
+{
+    simd_float3 minimum = vertices[0].position.xyz;
+    simd_float3 maximum = vertices[0].position.xyz;
+    for (size_t i = 1; i < count; i++)
+    {
+        minimum = simd_min(minimum, vertices[i].position.xyz);
+        maximum = simd_max(maximum, vertices[i].position.xyz);
+    }
+
+    // Center the sphere on the bounding box and grow it to reach the farthest vertex.
+    simd_float3 center = (minimum + maximum) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (size_t i = 0; i < count; i++)
+    {
+        radiusSquared = std::max(radiusSquared, simd_distance_squared(center, vertices[i].position.xyz));
+    }
+    return simd_make_float4(center, sqrtf(radiusSquared));
+}
+
+/// Returns the largest distance between the vertices of a patch's finest LOD and the surface of a coarser LOD.
+///
+/// The method bilinearly interpolates the coarse grid at the parametric coordinates of each fine vertex.
+float measureLODError(const AAPLVertex* fine, size_t fineX, size_t fineY,
+                      const AAPLVertex* coarse, size_t coarseX, size_t coarseY)
+{
+    float error = 0.0f;
+    for (size_t j = 0; j < fineY; j++)
+    {
+        float y = j * float(coarseY - 1) / float(fineY - 1);
+        size_t cj = std::min<size_t>(size_t(y), coarseY - 2);
+        float fy = y - cj;
+        for (size_t i = 0; i < fineX; i++)
+        {
+            float x = i * float(coarseX - 1) / float(fineX - 1);
+            size_t ci = std::min<size_t>(size_t(x), coarseX - 2);
+            float fx = x - ci;
+
+            const AAPLVertex* cell = coarse + cj * coarseX + ci;
+            simd_float3 p0 = simd_mix(cell[0].position.xyz, cell[1].position.xyz, fx);
+            simd_float3 p1 = simd_mix(cell[coarseX].position.xyz, cell[coarseX + 1].position.xyz, fx);
+            simd_float3 p = simd_mix(p0, p1, fy);
+            error = std::max(error, simd_distance(p, fine[j * fineX + i].position.xyz));
+        }
+    }
+    return error;
 }
 
 /// Calculates the index data for a bicubic patch and returns the number of indices the method adds to the array.
@@ -175,13 +240,13 @@ size_t makePatchIndices(size_t segmentsX, size_t segmentsY, size_t startIndex, s
         for (size_t i = 0; i < segmentsX-1; i++)
         {
             // The first part of the quad.
-            indices[index+0] = (uint16_t)(((j + 0) * segmentsX) + ((i + 1)));
-            indices[index+1] = (uint16_t)(((j + 1) * segmentsX) + ((i + 0)));
-            indices[index+2] = (uint16_t)(((j + 0) * segmentsX) + ((i + 0)));
+            indices[index+0] = (AAPLIndexType)(((j + 0) * segmentsX) + ((i + 1)));
+            indices[index+1] = (AAPLIndexType)(((j + 1) * segmentsX) + ((i + 0)));
+            indices[index+2] = (AAPLIndexType)(((j + 0) * segmentsX) + ((i + 0)));
             // The opposite side of the quad.
-            indices[index+3] = (uint16_t)(((j + 1) * segmentsX) + ((i + 1)));
-            indices[index+4] = (uint16_t)(((j + 1) * segmentsX) + ((i + 0)));
-            indices[index+5] = (uint16_t)(((j + 0) * segmentsX) + ((i + 1)));
+            indices[index+3] = (AAPLIndexType)(((j + 1) * segmentsX) + ((i + 1)));
+            indices[index+4] = (AAPLIndexType)(((j + 1) * segmentsX) + ((i + 0)));
+            indices[index+5] = (AAPLIndexType)(((j + 0) * segmentsX) + ((i + 1)));
 
             index += 6;
         }
@@ -201,7 +266,7 @@ void addLODs(AAPLIndexRange& lod, size_t segX, size_t segY, std::vector<AAPLInde
     // This helps keep the number of transformed vertices low for small LODs.
     for (size_t i = lod.startIndex; i < lod.lastIndex; i++)
     {
-        lod.vertexCount = std::max<uint16_t>(lod.vertexCount, meshIndices[i]);
+        lod.vertexCount = std::max<uint32_t>(lod.vertexCount, meshIndices[i]);
     }
     
     // The vertex count is one more than the highest index that the system finds.
@@ -238,15 +303,16 @@ AAPLRenderer::AAPLRenderer(MTK::View& view)
     _pCommandQueue = _pDevice->newCommandQueue();
     for (size_t i = 0; i < AAPLMaxFramesInFlight; i++) {
         _pTransformsBuffer[i] = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(matrix_float4x4), MTL::ResourceStorageModeShared);
+        _transformsDegree[i] = NAN;
     }
     _pMeshColorsBuffer = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(vector_float3), MTL::ResourceStorageModeShared);
-    const size_t LODCount = 3;
-    _pMeshVerticesBuffer = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(AAPLVertex) * AAPLMaxMeshletVertexCount * LODCount, MTL::ResourceStorageModeShared);
-    _pMeshIndicesBuffer = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(AAPLIndexType) * AAPLMaxPrimitiveCount * 6 * LODCount, MTL::ResourceStorageModeShared);
+    _pMeshVerticesBuffer = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(AAPLVertex) * AAPLMaxMeshletVertexCount * AAPLMaxLODCount, MTL::ResourceStorageModeShared);
+    _pMeshIndicesBuffer = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(AAPLIndexType) * AAPLMaxPrimitiveCount * 6 * AAPLMaxLODCount, MTL::ResourceStorageModeShared);
     _pMeshInfoBuffer = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(AAPLMeshInfo), MTL::ResourceStorageModeShared);
     buildShaders();
     makeMeshlets();
     makeMeshletColors();
+    makeObjectPositions();
 }
 
 /// Releases the renderer's GPU resources, including buffers and pipeline states.
@@ -325,42 +391,98 @@ void AAPLRenderer::buildShaders()
     depthStencilDesc->release();
 }
 
+/// The shared state for tessellating the bicubic patches in parallel.
+struct AAPLTessellationContext
+{
+    const AAPLBernsteinTable* tables[AAPLMaxLODCount][2];
+    const AAPLBicubicPatch* patches;
+    AAPLMeshInfo* meshInfo;
+    AAPLVertex* vertices;
+};
+
+/// Tessellates every LOD of one bicubic patch into the vertex ranges that the patch's mesh info reserves,
+/// and records the bounds and error the object shader uses to cull and select each LOD.
+static void tessellatePatch(void* context, size_t i)
+{
+    const AAPLTessellationContext* tessellation = static_cast<const AAPLTessellationContext*>(context);
+    AAPLMeshInfo& mesh = tessellation->meshInfo[i];
+    const AAPLVertex* finest = tessellation->vertices + mesh.lods[0].startVertexIndex;
+
+    for (uint32_t lod = 0; lod < mesh.numLODs; lod++)
+    {
+        const AAPLBernsteinTable& uTable = *tessellation->tables[lod][0];
+        const AAPLBernsteinTable& vTable = *tessellation->tables[lod][1];
+        AAPLVertex* vertices = tessellation->vertices + mesh.lods[lod].startVertexIndex;
+        size_t vertexCount = makePatchVertices(tessellation->patches[i], uTable, vTable, vertices);
+        mesh.lods[lod].boundingSphere = makeBoundingSphere(vertices, vertexCount);
+
+        // The finest LOD is the reference, so it has no error.
+        mesh.lods[lod].error = 0.0f;
+        if (lod > 0)
+        {
+            mesh.lods[lod].error = measureLODError(finest,
+                                                   tessellation->tables[0][0]->segments,
+                                                   tessellation->tables[0][1]->segments,
+                                                   vertices, uTable.segments, vTable.segments);
+        }
+    }
+}
+
 /// Initializes the meshlet vertex data for all the bicubic patches.
 void AAPLRenderer::makeMeshlets()
 {
-    size_t segX = AAPLNumPatchSegmentsX;
-    size_t segY = AAPLNumPatchSegmentsY;
-    meshVertices.clear();
+    const size_t segments[AAPLMaxLODCount][2] = {
+        { AAPLNumPatchSegmentsX, AAPLNumPatchSegmentsY },
+        { 5, 5 },
+        { 3, 3 }
+    };
+
+    // Every patch at a given LOD samples the same parametric coordinates, so build the basis tables once.
+    AAPLBernsteinTable tables[AAPLMaxLODCount][2];
+    for (size_t lod = 0; lod < AAPLMaxLODCount; lod++)
+    {
+        tables[lod][0] = makeBernsteinTable(segments[lod][0]);
+        tables[lod][1] = makeBernsteinTable(segments[lod][1]);
+    }
+
+    std::vector<AAPLBicubicPatch> patches(AAPLNumObjectsXYZ);
     meshIndices.clear();
     meshInfo.resize(AAPLNumObjectsXYZ);
+
+    // Lay out the vertex ranges and indices serially so they match the order the object shader expects.
+    uint32_t vertexCount = 0;
     for (int i = 0; i < AAPLNumObjectsXYZ; i++)
     {
         AAPLMeshInfo& mesh = meshInfo[i];
         mesh.patchIndex = i;
         mesh.color = simd_make_float4(1.0, 0.0, 1.0, 1.0);
-        mesh.numLODs = 3;
-        
-        if (mesh.numLODs >= 1)
-        {
-            mesh.lod1.startVertexIndex = (uint32_t)meshVertices.size();
-            mesh.vertexCount = (uint16_t)makePatchVertices(mesh.patchIndex, segX, segY, meshVertices);
-            addLODs(mesh.lod1, segX, segY, meshIndices);
-        }
-        
-        if (mesh.numLODs >= 2)
-        {
-            mesh.lod2.startVertexIndex = (uint32_t)meshVertices.size();
-            mesh.vertexCount += (uint16_t)makePatchVertices(mesh.patchIndex, 5, 5, meshVertices);
-            addLODs(mesh.lod2, 5, 5, meshIndices);
-        }
-        
-        if (mesh.numLODs >= 3)
+        mesh.numLODs = (uint16_t)AAPLMaxLODCount;
+        mesh.vertexCount = 0;
+        patches[i] = makeBicubicPatch();
+
+        for (size_t lod = 0; lod < mesh.numLODs; lod++)
         {
-            mesh.lod3.startVertexIndex = (uint32_t)meshVertices.size();
-            mesh.vertexCount += (uint16_t)makePatchVertices(mesh.patchIndex, 3, 3, meshVertices);
-            addLODs(mesh.lod3, 3, 3, meshIndices);
+            size_t segX = segments[lod][0];
+            size_t segY = segments[lod][1];
+            mesh.lods[lod].startVertexIndex = vertexCount;
+            mesh.vertexCount += (uint16_t)(segX * segY);
+            vertexCount += (uint32_t)(segX * segY);
+            addLODs(mesh.lods[lod], segX, segY, meshIndices);
         }
     }
+
+    // Evaluate the patches concurrently; each one writes only to its own vertex ranges and mesh info.
+    meshVertices.resize(vertexCount);
+    AAPLTessellationContext tessellation;
+    for (size_t lod = 0; lod < AAPLMaxLODCount; lod++)
+    {
+        tessellation.tables[lod][0] = &tables[lod][0];
+        tessellation.tables[lod][1] = &tables[lod][1];
+    }
+    tessellation.patches = patches.data();
+    tessellation.meshInfo = meshInfo.data();
+    tessellation.vertices = meshVertices.data();
+    dispatch_apply_f(AAPLNumObjectsXYZ, DISPATCH_APPLY_AUTO, &tessellation, tessellatePatch);
     
     // Tell Metal when the buffer contents change.
     assert(_pMeshVerticesBuffer->length() >= meshVertices.size() * sizeof(AAPLVertex));
@@ -395,14 +517,12 @@ void AAPLRenderer::makeMeshletColors()
     }
 }
 
-/// Updates the object transform matrix state before other methods encode any render commands.
-void AAPLRenderer::updateStage()
+/// Sets up the position of each bicubic patch in the grid.
+void AAPLRenderer::makeObjectPositions()
 {
-    // Get the array pointers for the buffers.
-    matrix_float4x4* transforms = reinterpret_cast<matrix_float4x4*>(_pTransformsBuffer[_curFrameInFlight]->contents());
+    objectPositions.resize(AAPLNumObjectsXYZ);
 
     int count = 0;
-    degree += rotationSpeed * M_PI / 180.0f;
 
     for (size_t z = 0; z < AAPLNumObjectsZ; ++z)
     {
@@ -413,13 +533,36 @@ void AAPLRenderer::updateStage()
             for (size_t x = 0; x < AAPLNumObjectsX; ++x)
             {
                 float x_pos = 2 * (x - (float(AAPLNumObjectsX - 1) / 2));
-                transforms[count] = matrix_multiply(matrix4x4_translation(x_pos, y_pos, z_pos), matrix4x4_YRotate(degree));
+                objectPositions[count] = simd_make_float4(x_pos, y_pos, z_pos, 1.0f);
                 count++;
             }
         }
     }
 }
 
+/// Updates the object transform matrix state before other methods encode any render commands.
+void AAPLRenderer::updateStage()
+{
+    degree += rotationSpeed * M_PI / 180.0f;
+
+    // Each frame in flight has its own transforms buffer, which only needs rewriting
+    // when the rotation changed since the last frame that used it.
+    if (_transformsDegree[_curFrameInFlight] == degree)
+        return;
+    _transformsDegree[_curFrameInFlight] = degree;
+
+    // Get the array pointers for the buffers.
+    matrix_float4x4* transforms = reinterpret_cast<matrix_float4x4*>(_pTransformsBuffer[_curFrameInFlight]->contents());
+
+    // Every object shares the same rotation, so translating it only replaces the last column.
+    matrix_float4x4 rotation = matrix4x4_YRotate(degree);
+    for (size_t i = 0; i < AAPLNumObjectsXYZ; i++)
+    {
+        rotation.columns[3] = objectPositions[i];
+        transforms[i] = rotation;
+    }
+}
+
 /// Draws the mesh shaders scene.
 void AAPLRenderer::draw(MTK::View* pView)
 {
@@ -451,7 +594,13 @@ void AAPLRenderer::draw(MTK::View* pView)
     pRenderEncoder->setObjectBuffer(_pTransformsBuffer[_curFrameInFlight], 0, AAPLBufferIndexTransforms);
     pRenderEncoder->setObjectBuffer(_pMeshColorsBuffer, 0, AAPLBufferIndexMeshColor);
     pRenderEncoder->setObjectBytes(&viewProjectionMatrix, sizeof(viewProjectionMatrix), AAPLBufferViewProjectionMatrix);
-    pRenderEncoder->setObjectBytes(&lodChoice, 4, AAPLBufferIndexLODChoice);
+
+    // Let the object stage coarsen a patch while the error it introduces stays under the pixel threshold.
+    AAPLLODSelection lodSelection;
+    lodSelection.lodChoice = lodChoice;
+    lodSelection.errorToPixels = _projectionMatrix.columns[1][1] * 0.5f * _drawableHeight;
+    lodSelection.maxPixelError = AAPLMaxLODPixelError;
+    pRenderEncoder->setObjectBytes(&lodSelection, sizeof(lodSelection), AAPLBufferIndexLODChoice);
 
     // Pass data to the mesh stage.
     pRenderEncoder->setMeshBytes(&viewProjectionMatrix, sizeof(viewProjectionMatrix), AAPLBufferViewProjectionMatrix);
@@ -480,5 +629,6 @@ void AAPLRenderer::draw(MTK::View* pView)
 void AAPLRenderer::drawableSizeWillChange(CGSize size)
 {
     float aspect = size.width / (float)size.height;
+    _drawableHeight = size.height;
     _projectionMatrix = matrix_perspective_right_hand(65.0f * (M_PI / 180.0f), aspect, 0.1f, 100.0f);
 }
@@ -32,6 +32,7 @@ public:
     
 private:
     static constexpr size_t AAPLMaxFramesInFlight = 3;
+    static constexpr float AAPLMaxLODPixelError = 0.5f;
     size_t _curFrameInFlight{0};
     
     MTL::Device* _pDevice;
@@ -39,6 +40,7 @@ private:
     MTL::RenderPipelineState* _pRenderPipelineState[3];
     MTL::DepthStencilState* _pDepthStencilState;
     MTL::Buffer* _pTransformsBuffer[AAPLMaxFramesInFlight];
+    float _transformsDegree[AAPLMaxFramesInFlight];
 
     MTL::Buffer* _pMeshColorsBuffer;
     MTL::Buffer* _pMeshVerticesBuffer;
@@ -46,13 +48,16 @@ private:
     MTL::Buffer* _pMeshInfoBuffer;
 
     matrix_float4x4 _projectionMatrix;
+    float _drawableHeight{1};
     float degree;
     
     std::vector<AAPLVertex> meshVertices;
     std::vector<AAPLIndexType> meshIndices;
     std::vector<AAPLMeshInfo> meshInfo;
+    std::vector<simd_float4> objectPositions;
     
     void updateStage();
+    void makeObjectPositions();
     void makeMeshlets();
     void makeMeshletColors();
 };
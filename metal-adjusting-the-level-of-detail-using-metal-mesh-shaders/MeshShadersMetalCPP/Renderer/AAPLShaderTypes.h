@@ -45,8 +45,14 @@ typedef struct AAPLIndexRange
     uint32_t startVertexIndex{0};
     uint32_t vertexCount{0};
     uint32_t primitiveCount{0};
+    // The sphere that bounds the LOD's vertices in model space, with the radius in `w`.
+    simd_float4 boundingSphere;
+    // The largest model-space distance between this LOD and the finest LOD of the mesh.
+    float error{0};
 } AAPLIndexRange;
 
+static constexpr constant uint32_t AAPLMaxLODCount = 3;
+
 typedef struct AAPLMeshInfo
 {
     uint16_t numLODs{3};
@@ -55,11 +61,21 @@ typedef struct AAPLMeshInfo
     
     uint16_t vertexCount{0};
     
-    AAPLIndexRange lod1;
-    AAPLIndexRange lod2;
-    AAPLIndexRange lod3;
+    // The LODs from finest to coarsest, where each LOD has a larger error than the one before it.
+    AAPLIndexRange lods[AAPLMaxLODCount];
 } AAPLMeshInfo;
 
+/// The parameters the object stage uses to select the LOD for each mesh.
+typedef struct AAPLLODSelection
+{
+    // The finest LOD the object stage may choose.
+    uint32_t lodChoice;
+    // The number of pixels a model-space distance covers at a clip-space depth of one.
+    float errorToPixels;
+    // The largest projected error, in pixels, that the object stage accepts from a coarser LOD.
+    float maxPixelError;
+} AAPLLODSelection;
+
 /// Declare the constant data for the entire frame in this structure.
 typedef struct
 {
@@ -67,7 +83,8 @@ typedef struct
     simd_float4x4 inverseTransform;
 } AAPLFrameData;
 
-using AAPLIndexType = uint16_t;
+/// Indices are local to a meshlet, which never has more than `AAPLMaxMeshletVertexCount` vertices.
+using AAPLIndexType = uint8_t;
 
 static constexpr constant uint32_t AAPLNumObjectsX = 16;
 static constexpr constant uint32_t AAPLNumObjectsY = 8;
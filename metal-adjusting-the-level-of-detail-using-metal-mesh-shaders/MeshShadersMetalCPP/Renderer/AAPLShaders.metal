@@ -77,6 +77,22 @@ using AAPLLineMeshType = metal::mesh<vertexOut, primOut, AAPLMaxMeshletVertexCou
 /// Defines a mesh declaration type that supports triangles.
 using AAPLTriangleMeshType = metal::mesh<vertexOut, primOut, AAPLMaxMeshletVertexCount, AAPLMaxPrimitiveCount, metal::topology::triangle>;
 
+/// Returns true if a sphere in model space lies entirely outside the view frustum.
+///
+/// The method extracts the frustum planes in model space from the rows of the model-view-projection matrix.
+static bool isSphereOutsideFrustum(float4 sphere, float4x4 modelViewProjectionMatrix)
+{
+    float4x4 m = transpose(modelViewProjectionMatrix);
+    float4 planes[6] = { m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2] };
+
+    for (uint i = 0; i < 6; i++)
+    {
+        if (dot(planes[i].xyz, sphere.xyz) + planes[i].w < -sphere.w * length(planes[i].xyz))
+            return true;
+    }
+    return false;
+}
+
 /// The object stage that generates one submesh group.
 [[object, max_total_threads_per_threadgroup(AAPLMaxTotalThreadsPerObjectThreadgroup), max_total_threadgroups_per_mesh_grid(AAPLMaxThreadgroupsPerMeshGrid)]]
 void meshShaderObjectStageFunction(object_data payload_t& payload            [[payload]],
@@ -87,7 +103,7 @@ void meshShaderObjectStageFunction(object_data payload_t& payload            [[p
                                    constant float4x4*   transforms           [[buffer(AAPLBufferIndexTransforms)]],
                                    constant float3*     colors               [[buffer(AAPLBufferIndexMeshColor)]],
                                    constant float4x4&   viewProjectionMatrix [[buffer(AAPLBufferViewProjectionMatrix)]],
-                                   constant uint&       lod                  [[buffer(AAPLBufferIndexLODChoice)]],
+                                   constant AAPLLODSelection& lodSelection   [[buffer(AAPLBufferIndexLODChoice)]],
                                    uint3                positionInGrid       [[threadgroup_position_in_grid]])
 {
     // threadIndex is the object index.
@@ -97,33 +113,35 @@ void meshShaderObjectStageFunction(object_data payload_t& payload            [[p
     
     constant AAPLMeshInfo& meshInfo = meshes[threadIndex];
     
-    payload.lod = 0;
     payload.color = colors[threadIndex];
-    
-    uint startIndex = meshInfo.lod1.startIndex;
-    uint startVertexIndex = meshInfo.lod1.startVertexIndex;
-    
-    // Adjust parameters if using a lower level of detail.
-    if (lod == 0)
-    {
-        payload.primitiveCount = meshInfo.lod1.primitiveCount;
-        payload.vertexCount = meshInfo.lod1.vertexCount;
-    }
-    else if (lod == 1)
+
+    // Concatenate the view projection matrix to the model transform matrix.
+    payload.transform = viewProjectionMatrix * transforms[threadIndex];
+
+    // Start at the chosen LOD, and coarsen while the next LOD's error projects to fewer pixels than the threshold.
+    // The depth of the nearest point of the patch's bounds gives the largest projected error.
+    float4 bounds = meshInfo.lods[0].boundingSphere;
+    float depth = max((payload.transform * float4(bounds.xyz, 1.0f)).w - bounds.w, 1e-3f);
+    float pixelsPerUnit = lodSelection.errorToPixels / depth;
+
+    uint lod = min(lodSelection.lodChoice, uint(meshInfo.numLODs) - 1);
+    while (lod + 1 < meshInfo.numLODs && meshInfo.lods[lod + 1].error * pixelsPerUnit <= lodSelection.maxPixelError)
     {
-        // Choose LOD 1.
-        startIndex = meshInfo.lod2.startIndex;
-        startVertexIndex = meshInfo.lod2.startVertexIndex;
-        payload.primitiveCount = meshInfo.lod2.primitiveCount;
-        payload.vertexCount = meshInfo.lod2.vertexCount;
+        lod++;
     }
-    else if (lod == 2)
+
+    constant AAPLIndexRange& range = meshInfo.lods[lod];
+    payload.lod = lod;
+    payload.primitiveCount = range.primitiveCount;
+    payload.vertexCount = range.vertexCount;
+    uint startIndex = range.startIndex;
+    uint startVertexIndex = range.startVertexIndex;
+
+    // Skip the mesh stage for a patch that's entirely outside the view.
+    if (isSphereOutsideFrustum(range.boundingSphere, payload.transform))
     {
-        // Choose LOD 2.
-        startIndex = meshInfo.lod3.startIndex;
-        startVertexIndex = meshInfo.lod3.startVertexIndex;
-        payload.primitiveCount = meshInfo.lod3.primitiveCount;
-        payload.vertexCount = meshInfo.lod3.vertexCount;
+        meshGridProperties.set_threadgroups_per_grid(uint3(0, 0, 0));
+        return;
     }
 
     // Copy the triangle indices into the payload.
@@ -137,9 +155,6 @@ void meshShaderObjectStageFunction(object_data payload_t& payload            [[p
     {
         payload.vertices[i] = vertices[startVertexIndex + i];
     }
-    
-    // Concatenate the view projection matrix to the model transform matrix.
-    payload.transform = viewProjectionMatrix * transforms[threadIndex];
 
     // Set the output submesh count for the mesh shader.
     // Because the mesh shader is only producing one mesh, the threadgroup grid size is 1 x 1 x 1.
@@ -8,6 +8,8 @@ The header-only class to read meta information for KTX11 texture files.
 #pragma once
 
 #include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
 #include <vector>
 #include <map>
 
@@ -38,87 +40,144 @@ class AAPLKTXTextureResource
 public:
     AAPLKTXTextureResource() {}
     
-    inline void readHeaderFromPath(const char* path)
+    /// Reads the header, key-value data, and mipmap level table, and checks every size and offset against the file length.
+    /// Returns false, and clears `valid`, if the file isn't a 2D KTX11 texture this class supports.
+    inline bool readHeaderFromPath(const char* path)
     {
         resourcePath = path;
+        valid = false;
         FILE* fin = fopen(path, "rb");
         if (!fin)
-            return;
-        fread((char*)&header, sizeof(KTXTextureHeader), 1, fin);
+            return false;
+        valid = readHeaderFromFile(fin);
+        fclose(fin);
+        return valid;
+    }
+    
+    inline bool readHeaderFromFile(FILE* fin)
+    {
+        // Discard the results of any earlier parse so a failure can't leave stale levels behind.
+        pixelFormat = MTLPixelFormatInvalid;
+        mipmapCount = 0;
+        imageDataSizeInBytes = 0;
+        mipmapFileOffsets.clear();
+        mipmapSizesInBytes.clear();
+        mipmapBytesPerRow.clear();
+        mipmapBytesPerImage.clear();
+        mipmapSizes.clear();
+        keyValuePairs.clear();
+        
+        struct stat fileInfo;
+        if (fstat(fileno(fin), &fileInfo) != 0)
+            return false;
+        const size_t fileSizeInBytes = fileInfo.st_size;
+        
+        if (fread((char*)&header, sizeof(KTXTextureHeader), 1, fin) != 1)
+            return false;
         
         uint8_t ktx1Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
-        bool isKTX1 = strncmp((char*)ktx1Identifier, (char*)header.identifier, 12) == 0;        
-        assert(isKTX1);
+        bool isKTX1 = memcmp(ktx1Identifier, header.identifier, 12) == 0;
+        if (!isKTX1 || header.endianness != 0x04030201)
+            return false;
+        
+        // Only accept single-face 2D textures, not 1D, 3D, array, or cube map textures.
+        if (header.pixelHeight == 0 || header.pixelDepth != 0 ||
+            header.numberOfArrayElements != 0 || header.numberOfFaces != 1)
+            return false;
+        
+        // A 2D texture has at most one mipmap level per bit of its largest dimension.
+        if (header.pixelWidth == 0 || header.numberOfMipmapLevels == 0 ||
+            header.numberOfMipmapLevels > 32 || (std::max(header.pixelWidth, header.pixelHeight) >> (header.numberOfMipmapLevels - 1)) == 0)
+            return false;
+        
+        size_t fileOffset = sizeof(KTXTextureHeader);
+        if (header.bytesOfKeyValueData > fileSizeInBytes - fileOffset)
+            return false;
+        
+        // Read the key-value data in one call and parse it in memory.
+        std::vector<char> keyValueData(header.bytesOfKeyValueData);
+        if (header.bytesOfKeyValueData && fread(keyValueData.data(), header.bytesOfKeyValueData, 1, fin) != 1)
+            return false;
+        fileOffset += header.bytesOfKeyValueData;
         
         size_t kvBytesRead = 0;
-        while (kvBytesRead < header.bytesOfKeyValueData)
+        while (kvBytesRead < keyValueData.size())
         {
+            if (keyValueData.size() - kvBytesRead < sizeof(uint32_t))
+                return false;
             uint32_t kvCount;
-            fread(&kvCount, 1, sizeof(uint32_t), fin);
-            // Align to 4 bytes boundary.
-            if (kvCount & 0x03) kvCount = (kvCount + 0x04) & ~0x03;
-            std::vector<char> buffer(kvCount);
-            fread(&buffer[0], kvCount, 1, fin);
+            memcpy(&kvCount, &keyValueData[kvBytesRead], sizeof(uint32_t));
+            kvBytesRead += sizeof(uint32_t);
+            if (kvCount > keyValueData.size() - kvBytesRead)
+                return false;
+            
             // Read the key-value pair that is separated by a '\0' character.
-            std::string values[2];
-            int vindex = 0;
-            for (auto c : buffer)
+            const char* pair = &keyValueData[kvBytesRead];
+            const char* keyEnd = (const char*)memchr(pair, 0, kvCount);
+            if (keyEnd)
             {
-                if (!c) vindex++;
-                if (vindex > 1) break;
-                if (c) values[vindex].push_back(c);
+                const char* value = keyEnd + 1;
+                const char* valueEnd = (const char*)memchr(value, 0, pair + kvCount - value);
+                keyValuePairs[std::string(pair, keyEnd)] = std::string(value, valueEnd ? valueEnd : pair + kvCount);
             }
-            keyValuePairs[values[0]] = values[1];
-            kvBytesRead += 4 + kvCount;
+            
+            // Align to 4 bytes boundary.
+            kvBytesRead += std::min<size_t>((kvCount + 0x03) & ~0x03, keyValueData.size() - kvBytesRead);
         }
-        assert(kvBytesRead == header.bytesOfKeyValueData);
         
         // Read mipmap sizes and offsets.
-        if (isKTX1)
+        pixelFormat = determinePixelFormat();
+        if (pixelFormat == MTLPixelFormatInvalid)
+            return false;
+        
+        // Record the offset and size of each mipmap level.
+        for (int level = 0; level < header.numberOfMipmapLevels; level++)
         {
-            pixelFormat = determinePixelFormat();
-            assert(pixelFormat != MTLPixelFormatInvalid);
-            mipmapCount = 0;
-            imageDataSizeInBytes = 0;
+            // The first four bytes of each mipmap level holds the size of the level image data.
+            uint32_t levelSizeInBytes;
+            if (fread((char*)&levelSizeInBytes, sizeof(uint32_t), 1, fin) != 1)
+                return false;
+            fileOffset += sizeof(uint32_t);
             
-            // Record the offset and size of each mipmap level.
-            for (int level = 0; level < header.numberOfMipmapLevels; level++)
+            // The image data must fit in the file.
+            size_t levelFileOffset = fileOffset;
+            if (levelSizeInBytes > fileSizeInBytes - levelFileOffset)
+                return false;
+            
+            // Record data sizes based on ASTC 4x4 block compression or bytesPerPixel.
+            MTLSize levelSize = MTLSizeMake(std::max<uint32_t>(header.pixelWidth>>level, 1), std::max<uint32_t>(header.pixelHeight>>level, 1), 1);
+            size_t bytesPerRow = 0;
+            size_t rowCount = 0;
+            if (compressed)
             {
-                // The first four bytes of each mipmap level holds the size of the level image data.
-                uint32_t levelSizeInBytes;
-                fread((char*)&levelSizeInBytes, sizeof(uint32_t), 1, fin);
-                
-                // But this size must also align to a four byte boundary.
-                if (levelSizeInBytes & 0x03) levelSizeInBytes = (levelSizeInBytes + 0x04) & 0x03;
-                
-                // Update the total amount of the image and get the current file offset.
-                imageDataSizeInBytes += levelSizeInBytes;
-                size_t levelFileOffset = ftell(fin);
-                
-                // Record the offsets and sizes.
-                mipmapFileOffsets.push_back(levelFileOffset);
-                mipmapSizesInBytes.push_back(levelSizeInBytes);
-
-                // Record data sizes based on ASTC 4x4 block compression or bytesPerPixel.
-                MTLSize levelSize = MTLSizeMake(header.pixelWidth>>level, header.pixelHeight>>level, 1);
-                size_t bytesPerRow = 0;
-                if (compressed)
-                    bytesPerRow = std::max<size_t>(levelSize.width / 4 * 16, 16);
-                else
-                    bytesPerRow = std::max<size_t>(levelSize.width * bytesPerPixel, 4);
-                
-                mipmapBytesPerRow.push_back(bytesPerRow);
-                mipmapBytesPerImage.push_back(bytesPerRow * levelSize.height);
-                mipmapSizes.push_back(levelSize);
-                
-                // Move forward the number of bytes for the image data to get to the next mipmap level.
-                fseek(fin, levelSizeInBytes, SEEK_CUR);
-
-                mipmapCount++;
+                bytesPerRow = (levelSize.width + 3) / 4 * 16;
+                rowCount = (levelSize.height + 3) / 4;
             }
+            else
+            {
+                bytesPerRow = levelSize.width * bytesPerPixel;
+                rowCount = levelSize.height;
+            }
+            if (bytesPerRow * rowCount > levelSizeInBytes)
+                return false;
+            
+            // Update the total amount of the image and record the offsets and sizes.
+            imageDataSizeInBytes += levelSizeInBytes;
+            mipmapFileOffsets.push_back(levelFileOffset);
+            mipmapSizesInBytes.push_back(levelSizeInBytes);
+            mipmapBytesPerRow.push_back(bytesPerRow);
+            mipmapBytesPerImage.push_back(bytesPerRow * rowCount);
+            mipmapSizes.push_back(levelSize);
+            
+            // Move forward the number of bytes for the image data, padded to a four byte boundary, to get to the next mipmap level.
+            fileOffset += std::min<size_t>((levelSizeInBytes + 0x03) & ~0x03, fileSizeInBytes - levelFileOffset);
+            if (fseek(fin, fileOffset, SEEK_SET) != 0)
+                return false;
+            
+            mipmapCount++;
         }
         
-        fclose(fin);
+        return true;
     }
     
     inline MTLPixelFormat determinePixelFormat()
@@ -162,5 +221,7 @@ public:
 
     std::string resourcePath;
     bool compressed{false};
+    /// True when the last call to readHeaderFromPath parsed the file successfully.
+    bool valid{false};
     std::map<std::string, std::string> keyValuePairs;
 };
@@ -368,7 +368,12 @@ NSString* loadStatusToString(enum LoadStatus status)
     
     _textures[i].resources[index] = nil;
     _textures[i].urls[index] = [[NSBundle mainBundle] URLForResource:ktxPath withExtension:nil];
-    _textures[i].ktx[index].readHeaderFromPath(_textures[i].urls[index].path.UTF8String);
+    if (!_textures[i].ktx[index].readHeaderFromPath(_textures[i].urls[index].path.UTF8String))
+    {
+        // The loading methods skip invalid textures, and the app keeps a texture at low resolution
+        // if its high-resolution file is invalid.
+        NSLog(@"Couldn't read the KTX header of %@", ktxPath);
+    }
 }
 
 #pragma mark - Traditional `fread` loading methods.
@@ -396,6 +401,10 @@ NSString* loadStatusToString(enum LoadStatus status)
 {
     AAPLKTXTextureResource& ktx = _textures[i].ktx[index];
     
+    // Skip a texture whose header failed to parse.
+    if (!ktx.valid)
+        return;
+    
     // Assert a few requirements on the file format.
     assert(ktx.header.pixelDepth == 0);
     assert(ktx.header.numberOfArrayElements == 0);
@@ -521,6 +530,10 @@ NSString* loadStatusToString(enum LoadStatus status)
 {
     auto& ktx = _textures[i].ktx[index];
     
+    // Skip a texture whose header failed to parse.
+    if (!ktx.valid)
+        return;
+    
     // Get the size and offset for this resource.
     NSURL* sourceURL = _textures[i].urls[index];
     
@@ -613,6 +626,10 @@ NSString* loadStatusToString(enum LoadStatus status)
             _textures[i].preferredIndex = SmallIndex;
         }
         
+        // Don't request a high-resolution texture that failed to parse.
+        if (!_textures[i].ktx[LargeIndex].valid)
+            _textures[i].preferredIndex = SmallIndex;
+        
         // Unload the model buffers and textures.
         _models[i].unload();
         _textures[i].unload();
@@ -15,6 +15,9 @@ NSData * _Nonnull uncompressData(NSData * _Nonnull data);
 size_t uncompressedDataSize(NSData * _Nonnull data);
 // Uncompresses a block of data to a dynamically allocated buffer.
 void uncompressData(NSData * _Nonnull data, uint8_t * _Nonnull(^ _Nonnull allocatorCallback)(size_t));
+// Uncompresses several blocks of data to preallocated buffers in parallel.
+//  Each buffer must hold `uncompressedDataSize` bytes of its block.
+void uncompressDataConcurrently(NSArray<NSData *> * _Nonnull data, uint8_t * _Nonnull const * _Nonnull dstBuffers);
 
 #if !TARGET_OS_IPHONE
 // Helper to get the properties of block compressed pixel formats used by this sample.
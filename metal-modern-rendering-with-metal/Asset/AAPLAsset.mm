@@ -117,6 +117,26 @@ void uncompressData(NSData *data, uint8_t *(^allocatorCallback)(size_t))
     uncompressData(*header, (header+1), dstBuffer);
 }
 
+void uncompressDataConcurrently(NSArray<NSData *> *data, uint8_t * const *dstBuffers)
+{
+    const size_t count = data.count;
+
+    // Validate every header before starting any work, so a bad block exits before decoding begins.
+    for (size_t i = 0; i < count; i++)
+    {
+        getCompressionHeader(data[i]);
+    }
+
+    // Each block is an independent compressed stream, so blocks decode in parallel
+    //  and the total time approaches that of the largest block.
+    dispatch_apply(count, DISPATCH_APPLY_AUTO, ^(size_t i)
+    {
+        const AAPLCompressionHeader* header = (const AAPLCompressionHeader *)data[i].bytes;
+
+        uncompressData(*header, (header+1), dstBuffers[i]);
+    });
+}
+
 //------------------------------------------------------------------------------
 
 #if !TARGET_OS_IPHONE
@@ -359,6 +379,16 @@ void getPixelFormatBlockDesc(MTLPixelFormat pixelFormat, NSUInteger &blockSize,
             return nil;
         }
 
+        if (header.dataOffset > fileInfo.st_size - sizeof(AAPLFileHeader))
+        {
+            NSLog(@"Mesh file is truncated");
+            munmap(mappedData, fileInfo.st_size);
+            return nil;
+        }
+
+        // The unarchiver reads the archive from front to back once.
+        madvise(mappedData, sizeof(AAPLFileHeader) + header.dataOffset, MADV_SEQUENTIAL);
+
         NSData *archivedData = [NSData dataWithBytesNoCopy:fileData
                                                     length:header.dataOffset
                                               freeWhenDone:NO];
@@ -382,15 +412,15 @@ void getPixelFormatBlockDesc(MTLPixelFormat pixelFormat, NSUInteger &blockSize,
                                                                  fromData:archivedData
                                                                     error:&error];
 
+        // The decoded objects own copies of their data, so the mapping is no longer needed.
+        munmap(mappedData, fileInfo.st_size);
+
         if (!mesh)
         {
             NSLog(@"Failed to decode mesh: %@", error);
-            munmap(mappedData, fileInfo.st_size);
             return nil;
         }
 
-        fileData += header.dataOffset;
-
         return mesh;
     }
 }
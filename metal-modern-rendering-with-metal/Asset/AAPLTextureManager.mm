@@ -12,9 +12,11 @@ Implementation of class tracking source (asset) textures.
 #import <unordered_map>
 #import <vector>
 #import <atomic>
+#import <algorithm>
 
 #define USE_SEPARATE_COMMAND_QUEUE  (1)
 #define MAX_BLIT_CMD_BUFFERS        (4)
+#define MAX_STREAMING_REQUESTS      (32)
 
 #define TRACK_STREAMING_STATS       (1 && USE_TEXTURE_STREAMING)
 
@@ -47,18 +49,24 @@ NSUInteger calculateMipSizeInBlocks(NSUInteger size, NSUInteger blockSize, NSUIn
 
 //----------------------------------------------------
 
-enum class RequestState
+enum class RequestState : uint32_t
 {
     NONE,
     IN_QUEUE,
     PROCESSING
 };
 
-struct TextureRequest
+struct RequestStatus
 {
-    NSUInteger      mip;
-    NSLock*         lock;
+    uint32_t        mip;
     RequestState    state;
+};
+
+// The main thread and the loading threads change a request's
+//  mip and state together with a single compare-and-swap instead of a lock.
+struct TextureRequest
+{
+    std::atomic<RequestStatus> status;
 
 #if TRACK_STREAMING_STATS
     uint64_t        time;
@@ -72,6 +80,7 @@ struct TextureEntry
     NSData*                 data;
     NSUInteger              currentMip;
     NSUInteger              requiredMip;
+    NSUInteger              permanentMip;           // Required mip when nothing requests more detail.
 
 #if SUPPORT_SPARSE_TEXTURES
     std::vector<int>        mipLastAccess;
@@ -94,6 +103,13 @@ struct TextureUpdate
     NSUInteger      mip;
 };
 
+struct StreamingCandidate
+{
+    unsigned int    hash;
+    TextureEntry*   entry;
+    NSInteger       mipDelta;   // Mips to load if positive, or mips to drop if negative.
+};
+
 #if TRACK_STREAMING_STATS
 struct StatsEntry
 {
@@ -137,6 +153,9 @@ struct PendingBlit
     NSLock*                    _lockCompletedRequests;
 
     std::vector<TextureUpdate> _texturesUpdates;
+
+    // Updates taken from `_texturesUpdates`, processed without holding the lock.
+    std::vector<TextureUpdate> _texturesUpdatesToProcess;
 #endif
 
 #if USE_TEXTURE_STREAMING
@@ -148,6 +167,8 @@ struct PendingBlit
 
     std::atomic_uint    _numRequests;
     std::atomic_uint    _numFailedRequests;
+
+    std::vector<StreamingCandidate> _streamingCandidates;
 #endif
 
 #if SUPPORT_SPARSE_TEXTURES
@@ -278,12 +299,17 @@ struct PendingBlit
     }
 #endif // SUPPORT_SPARSE_TEXTURES
 
+    // Take the completed requests so that handlers completing now don't wait on this update.
     [_lockCompletedRequests lock];
 
+    std::swap(_texturesUpdates, _texturesUpdatesToProcess);
+
+    [_lockCompletedRequests unlock];
+
     // Process sucessfull texture updates
-    if(_texturesUpdates.size() > 0)
+    if(_texturesUpdatesToProcess.size() > 0)
     {
-        _numRequests -= (uint)_texturesUpdates.size();
+        _numRequests -= (uint)_texturesUpdatesToProcess.size();
 
 #if TRACK_STREAMING_STATS
         double tbConversionFactor = 0;
@@ -297,20 +323,20 @@ struct PendingBlit
         uint64_t currentTime = mach_absolute_time();
 #endif
 
-        for(const auto& update : _texturesUpdates)
+        for(const auto& update : _texturesUpdatesToProcess)
         {
             assert(_textures.find(update.hash) != _textures.end());
 
             TextureEntry& te = _textures[update.hash];
 
-            assert(te.request.state == RequestState::PROCESSING);
+            assert(te.request.status.load(std::memory_order_relaxed).state == RequestState::PROCESSING);
 
             // Need to keep reference to textures since GPU might still read them
             _textureToDelete[frameIndex].push_back(te.texture);
 
             te.texture          = update.texture;
             te.currentMip       = update.mip;
-            te.request.state    = RequestState::NONE;
+            te.request.status.store({ (uint32_t)update.mip, RequestState::NONE }, std::memory_order_release);
 
 #if TRACK_STREAMING_STATS
             double latency = (currentTime - te.request.time) * tbConversionFactor;
@@ -321,11 +347,9 @@ struct PendingBlit
 #endif
         }
 
-        _texturesUpdates.clear();
+        _texturesUpdatesToProcess.clear();
     }
 
-    [_lockCompletedRequests unlock];
-
 #if TRACK_STREAMING_STATS
     _statsTimeAccum += deltaTime;
 
@@ -347,7 +371,10 @@ struct PendingBlit
     }
 #endif
 
-    // Submit new streaming requests
+    // Gather textures that need new streaming requests, and clear required mips
+    //  for next frame on the textures that don't.
+    _streamingCandidates.clear();
+
     for(auto& kv : _textures)
     {
         TextureEntry& te = kv.second;
@@ -362,12 +389,35 @@ struct PendingBlit
             te.requiredMip = MIN(te.requiredMip, te.texture.firstMipmapInTail);
         }
 #endif
-        if(te.currentMip != te.requiredMip && te.request.mip != te.requiredMip)
+        if(te.currentMip != te.requiredMip && te.request.status.load(std::memory_order_relaxed).mip != te.requiredMip)
+        {
+            _streamingCandidates.push_back({ kv.first, &te, (NSInteger)te.currentMip - (NSInteger)te.requiredMip });
+        }
+        else
         {
-            [self request:kv.first];
+            te.requiredMip = te.permanentMip;
         }
     }
 
+    // Submit drops first since they free heap space for loads, then the loads
+    //  missing the most detail, until the number of requests in flight reaches the limit.
+    std::sort(_streamingCandidates.begin(), _streamingCandidates.end(),
+              [](const StreamingCandidate& a, const StreamingCandidate& b)
+    {
+        if((a.mipDelta < 0) != (b.mipDelta < 0))
+            return a.mipDelta < 0;
+
+        return a.mipDelta > b.mipDelta;
+    });
+
+    for(const StreamingCandidate& candidate : _streamingCandidates)
+    {
+        if(_numRequests < MAX_STREAMING_REQUESTS)
+            [self request:candidate.hash];
+
+        candidate.entry->requiredMip = candidate.entry->permanentMip;
+    }
+
 #if 0
     if(_numFailedRequests > 0)
         printf("Skipped %u requests because allocations failed.\n", (int)_numFailedRequests);
@@ -375,10 +425,6 @@ struct PendingBlit
 
     _numFailedRequests = 0;
 
-    // clear required mips for next frame
-    for(auto& kv : _textures)
-        kv.second.requiredMip = calculateMinMip(kv.second.desc, _permanentTextureSize);
-
 #endif //USE_TEXTURE_STREAMING
 }
 
@@ -455,12 +501,13 @@ struct PendingBlit
 
 #endif // SUPPORT_SPARSE_TEXTURES
 
-            TextureEntry te;
+            TextureEntry& te = _textures[textureHash];
             te.texture      = texture;
             te.desc         = textureAsset;
             te.data         = data;
             te.currentMip   = minMip;
             te.requiredMip  = minMip;
+            te.permanentMip = calculateMinMip(textureAsset, _permanentTextureSize);
 
 #if SUPPORT_SPARSE_TEXTURES
             if(_useSparseTextures)
@@ -476,11 +523,7 @@ struct PendingBlit
             }
 #endif // SUPPORT_SPARSE_TEXTURES
 
-            te.request.mip      = minMip;
-            te.request.lock     = [NSLock new];
-            te.request.state    = RequestState::NONE;
-
-            _textures[textureHash] = te;
+            te.request.status.store({ (uint32_t)minMip, RequestState::NONE }, std::memory_order_relaxed);
         }
     }
 
@@ -548,46 +591,46 @@ struct PendingBlit
     }
 #endif //SUPPORT_SPARSE_TEXTURES
 
-    [te.request.lock lock];
-
     assert(te.requiredMip != te.currentMip);
 
-    bool newRequest = (te.request.state == RequestState::NONE);
-
-    if(te.request.state != RequestState::PROCESSING)
+    // Retarget a queued request to the new mip, or queue a new one. A loading
+    //  thread may start processing the request at any time, after which it can't change.
+    RequestStatus status = te.request.status.load(std::memory_order_relaxed);
+    bool newRequest;
+    do
     {
-        te.request.mip      = te.requiredMip;
-        te.request.state    = RequestState::IN_QUEUE;
+        if(status.state == RequestState::PROCESSING)
+            return;
+
+        newRequest = (status.state == RequestState::NONE);
     }
+    while(!te.request.status.compare_exchange_weak(status, { (uint32_t)te.requiredMip, RequestState::IN_QUEUE },
+                                                   std::memory_order_release, std::memory_order_relaxed));
 
-    assert(te.request.mip != te.currentMip);
+    if(!newRequest)
+        return;
 
 #if TRACK_STREAMING_STATS
-    if(newRequest)
-        te.request.time = mach_absolute_time();
+    te.request.time = mach_absolute_time();
 #endif
 
-    [te.request.lock unlock];
-
-    if(!newRequest)
-        return;
-
     ++_numRequests;
 
     dispatch_async(_loadingQueue, ^
     {
-        [te.request.lock lock];
-
-        assert(te.request.state == RequestState::IN_QUEUE);
-
-        te.request.state = RequestState::PROCESSING;
+        // Claim the request at whichever mip it targets now.
+        RequestStatus status = te.request.status.load(std::memory_order_relaxed);
+        do
+        {
+            assert(status.state == RequestState::IN_QUEUE);
+        }
+        while(!te.request.status.compare_exchange_weak(status, { status.mip, RequestState::PROCESSING },
+                                                       std::memory_order_acquire, std::memory_order_relaxed));
 
-        NSUInteger mipLevel = te.request.mip;
+        NSUInteger mipLevel = status.mip;
 
         assert(mipLevel != te.currentMip);
 
-        [te.request.lock unlock];
-
 #if SUPPORT_SPARSE_TEXTURES
         const bool dropMips = te.currentMip < mipLevel;
 #else
@@ -611,12 +654,8 @@ struct PendingBlit
 
             if(newTexture == nil)
             {
-                [te.request.lock lock];
-
-                te.request.mip      = te.currentMip; // reset request so we try again later
-                te.request.state    = RequestState::NONE;
-
-                [te.request.lock unlock];
+                // reset request so we try again later
+                te.request.status.store({ (uint32_t)te.currentMip, RequestState::NONE }, std::memory_order_release);
 
                 --self->_numRequests;
                 ++self->_numFailedRequests;
@@ -913,6 +952,8 @@ struct PendingBlit
     id<MTLResourceStateCommandEncoder> encoder  = [cmdBuffer resourceStateCommandEncoder];
     encoder.label                               = @"Sparse Texture Unmapping Encoder";
 
+    std::vector<TextureUpdate> updates;
+
     for(auto& kv : _textures)
     {
         TextureEntry& te = kv.second;
@@ -925,22 +966,19 @@ struct PendingBlit
 
         if(firstGPUMip - te.currentMip > 0)
         {
-            [te.request.lock lock];
+            RequestStatus idle = te.request.status.load(std::memory_order_relaxed);
 
-            if(te.request.state != RequestState::NONE)
+            if(idle.state != RequestState::NONE ||
+               !te.request.status.compare_exchange_strong(idle, { (uint32_t)firstGPUMip, RequestState::PROCESSING },
+                                                          std::memory_order_acquire, std::memory_order_relaxed))
             {
-                [te.request.lock unlock];
                 continue;
             }
-            te.request.mip      = firstGPUMip;
-            te.request.state    = RequestState::PROCESSING;
 
 #if TRACK_STREAMING_STATS
             te.request.time = mach_absolute_time();
 #endif
 
-            [te.request.lock unlock];
-
             ++_numRequests;
 
             // drop mips
@@ -951,23 +989,30 @@ struct PendingBlit
                             mappingMode:MTLSparseTextureMappingModeUnmap
                               onEncoder:encoder];
 
-            [cmdBuffer addCompletedHandler:^(id<MTLCommandBuffer> _Nonnull)
-            {
-                TextureUpdate update;
-                update.hash     = kv.first;
-                update.texture  = te.texture;
-                update.mip      = firstGPUMip;
-
-                [self->_lockCompletedRequests lock];
-
-                self->_texturesUpdates.push_back(update);
+            TextureUpdate update;
+            update.hash     = kv.first;
+            update.texture  = te.texture;
+            update.mip      = firstGPUMip;
 
-                [self->_lockCompletedRequests unlock];
-            }];
+            updates.push_back(update);
         }
     }
 
     [encoder endEncoding];
+
+    if(!updates.empty())
+    {
+        // Report every dropped texture from a single handler.
+        [cmdBuffer addCompletedHandler:^(id<MTLCommandBuffer> _Nonnull)
+        {
+            [self->_lockCompletedRequests lock];
+
+            self->_texturesUpdates.insert(self->_texturesUpdates.end(), updates.begin(), updates.end());
+
+            [self->_lockCompletedRequests unlock];
+        }];
+    }
+
     [cmdBuffer commit];
 }
 #endif // SUPPORT_SPARSE_TEXTURES
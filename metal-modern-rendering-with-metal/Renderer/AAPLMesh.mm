@@ -85,36 +85,44 @@ Implemenation of class storing data to draw a mesh including vertex buffers, sub
         NSData *compressedChunkData     = mesh.chunkData;
 
         MTLResourceOptions options = 0;
-        uncompressData(compressedVertexData,    ^(size_t size) {
-            self->_vertices = [device newBufferWithLength:size options:options];
-            self->_vertices.label   = @"Vertices";
-            return (uint8_t *)self->_vertices.contents;
-        });
-        uncompressData(compressedNormalData,    ^(size_t size) {
-            self->_normals = [device newBufferWithLength:size options:options];
-            self->_normals.label    = @"Normals";
-            return (uint8_t *)self->_normals.contents;
-        });
-        uncompressData(compressedTangentData,   ^(size_t size) {
-            self->_tangents = [device newBufferWithLength:size options:options];
-            self->_tangents.label   = @"Tangents";
-            return (uint8_t *)self->_tangents.contents;
-        });
-        uncompressData(compressedUVData,        ^(size_t size) {
-            self->_uvs = [device newBufferWithLength:size options:options];
-            self->_uvs.label        = @"UVs";
-            return (uint8_t *)self->_uvs.contents;
-        });
-        uncompressData(compressedIndexData,     ^(size_t size) {
-            self->_indices = [device newBufferWithLength:size options:options];
-            self->_indices.label    = @"Indices";
-            return (uint8_t *)self->_indices.contents;
-        });
-        uncompressData(compressedChunkData,     ^(size_t size) {
-            self->_chunks = [device newBufferWithLength:size options:options];
-            self->_chunks.label     = @"Chunks";
-            return (uint8_t *)self->_chunks.contents;
-        });
+        auto NewBuffer = [&](NSData *compressedData, NSString *label)
+        {
+            id<MTLBuffer> buffer = [device newBufferWithLength:uncompressedDataSize(compressedData) options:options];
+            buffer.label = label;
+            return buffer;
+        };
+        self->_vertices = NewBuffer(compressedVertexData,   @"Vertices");
+        self->_normals  = NewBuffer(compressedNormalData,   @"Normals");
+        self->_tangents = NewBuffer(compressedTangentData,  @"Tangents");
+        self->_uvs      = NewBuffer(compressedUVData,       @"UVs");
+        self->_indices  = NewBuffer(compressedIndexData,    @"Indices");
+        self->_chunks   = NewBuffer(compressedChunkData,    @"Chunks");
+
+        NSMutableData *materialData = [NSMutableData dataWithLength:uncompressedDataSize(compressedMaterialData)];
+        NSMutableData *meshData     = [NSMutableData dataWithLength:uncompressedDataSize(compressedMeshData)];
+
+        // Decode all of the blocks at once, rather than one after another.
+        NSArray<NSData *> *compressedBlocks =
+        @[
+            compressedVertexData, compressedNormalData, compressedTangentData, compressedUVData,
+            compressedIndexData, compressedChunkData, compressedMaterialData, compressedMeshData
+        ];
+        uint8_t * const dstBuffers[] =
+        {
+            (uint8_t *)self->_vertices.contents, (uint8_t *)self->_normals.contents,
+            (uint8_t *)self->_tangents.contents, (uint8_t *)self->_uvs.contents,
+            (uint8_t *)self->_indices.contents, (uint8_t *)self->_chunks.contents,
+            (uint8_t *)materialData.mutableBytes, (uint8_t *)meshData.mutableBytes
+        };
+        assert(compressedBlocks.count == sizeof(dstBuffers) / sizeof(dstBuffers[0]));
+
+        uncompressDataConcurrently(compressedBlocks, dstBuffers);
+
+        _materialData   = materialData;
+        _meshData       = meshData;
+        // Keep a CPU copy of the chunks before the buffer may move to private storage,
+        //  instead of decoding the chunk block a second time.
+        _chunkData      = [NSData dataWithBytes:self->_chunks.contents length:self->_chunks.length];
 
         if(!device.hasUnifiedMemory)
         {
@@ -140,10 +148,6 @@ Implemenation of class storing data to draw a mesh including vertex buffers, sub
             [cmdBuffer commit];
         }
 
-        _materialData   = uncompressData(compressedMaterialData);
-        _meshData       = uncompressData(compressedMeshData);
-        _chunkData      = uncompressData(compressedChunkData);
-
         _vertexCount            = mesh.vertexCount;
         _indexCount             = mesh.indexCount;
 
@@ -330,6 +330,7 @@ struct AAPLFrameData
 
     AAPLConfig      _config;
     uint            _lightState; // 0 - Off, 1 - Point, 2 - Point + Spot
+    uint            _visiblePointLightCount; // Point lights packed into the current frame's buffers.
     bool            _occludersEnabled;
 
     // Debug settings.
@@ -2218,22 +2219,32 @@ static float halton(uint32_t index, uint32_t base)
 
     AAPLPointLightData* pointLights = (AAPLPointLightData*)currentFrame.pointLightsBuffer.contents;
     AAPLPointLightCullingData* pointLightCulling = (AAPLPointLightCullingData *)currentFrame.pointLightsCullingBuffer.contents;
+    _visiblePointLightCount = 0;
     if (_scene.pointLightCount > 0)
     {
-        memcpy(pointLights, _scene.pointLights, _scene.pointLightCount * sizeof(AAPLPointLightData));
+        // Pack only the lights that intersect the view frustum to the front of the buffers,
+        //  so the coarse culling, tiled culling and clustering passes skip lights that can't affect the view.
+        const AAPLPointLightData* scenePointLights = _scene.pointLights;
 
         for(NSUInteger i = 0; i < _scene.pointLightCount; i++)
         {
-            simd::float4 boundingSphere = cameraParams->viewMatrix * make_float4(pointLights[i].posSqrRadius.xyz, 1.0f);
+            float radius = sqrtf(scenePointLights[i].posSqrRadius.w);
 
-            float radius = sqrtf(pointLights[i].posSqrRadius.w);
-            bool transparent_flag = (pointLights[i].flags & LIGHT_FOR_TRANSPARENT_FLAG) > 0;
+            if(!sphereInFrustum(*cameraParams, AAPLSphere(scenePointLights[i].posSqrRadius.xyz, radius)))
+                continue;
+
+            uint lightIndex = _visiblePointLightCount++;
+            pointLights[lightIndex] = scenePointLights[i];
+
+            simd::float4 boundingSphere = cameraParams->viewMatrix * make_float4(scenePointLights[i].posSqrRadius.xyz, 1.0f);
+
+            bool transparent_flag = (scenePointLights[i].flags & LIGHT_FOR_TRANSPARENT_FLAG) > 0;
             boundingSphere.w = transparent_flag ? radius : -radius;
 
             AAPLPointLightCullingData pointLightCullingData;
             pointLightCullingData.posRadius = boundingSphere;
 
-            pointLightCulling[i] = pointLightCullingData;
+            pointLightCulling[lightIndex] = pointLightCullingData;
         }
     }
 
@@ -2380,6 +2391,9 @@ static float halton(uint32_t index, uint32_t base)
 {
     uint2 lightCount = [self getMaxLightCount];
 
+    // Only the lights inside the view frustum are in the current frame's point light buffers.
+    lightCount.x = _visiblePointLightCount;
+
     if(_lightState == 0)
     {
         lightCount.x = 0;
@@ -3398,6 +3412,8 @@ static float halton(uint32_t index, uint32_t base)
     if (![AAPLDepthPyramid isPyramidTextureValidForDepth:_depthPyramidTexture
                                             depthTexture:_depthTexture])
     {
+        [_depthPyramid invalidateMipViewsForPyramidTexture:_depthPyramidTexture];
+
         _depthPyramidTexture = [AAPLDepthPyramid allocatePyramidTextureFromDepth:_depthTexture
                                                                           device:_device];
         _depthPyramidTexture.label  = @"DepthPyramid";
@@ -3412,6 +3428,8 @@ static float halton(uint32_t index, uint32_t base)
     if (![AAPLDepthPyramid isPyramidTextureValidForDepth:_saoMippedDepth
                                             depthTexture:_depthTexture])
     {
+        [_depthPyramid invalidateMipViewsForPyramidTexture:_saoMippedDepth];
+
         _saoMippedDepth = [AAPLDepthPyramid allocatePyramidTextureFromDepth:_depthTexture
                                                                      device:_device];
         _saoMippedDepth.label = @"SAOMippedDepth";
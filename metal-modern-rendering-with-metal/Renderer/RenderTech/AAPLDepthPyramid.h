@@ -20,6 +20,10 @@ Header for class which generates a depth pyramid (i.e. depth mipmaps) from a dep
     depthTexture:(nonnull id<MTLTexture>)depthTexture
        onEncoder:(nonnull id<MTLComputeCommandEncoder>)encoder;
 
+// Releases the cached mip views of a pyramid texture the caller is about to replace.
+//  The views retain their parent texture, so call this before reallocating a pyramid.
+- (void)invalidateMipViewsForPyramidTexture:(_Nullable id<MTLTexture>)pyramidTexture;
+
 // Checks if the specified pyramid texture is valid for the depth texture.
 //  If not, it should be allocated with allocatePyramidTextureFromDepth.
 + (bool)isPyramidTextureValidForDepth:(_Nullable id<MTLTexture>)pyramidTexture
@@ -13,6 +13,10 @@ Header for class which generates a depth pyramid (i.e. depth mipmaps) from a dep
 #import <simd/simd.h>
 #import <Foundation/Foundation.h>
 
+// Maximum number of pyramid textures with cached mip views.
+//  The renderer regenerates the main view and ambient obscurance pyramids every frame.
+static const NSUInteger MaxCachedPyramidTextures = 4;
+
 @implementation AAPLDepthPyramid
 {
     // Device from initialization.
@@ -20,6 +24,11 @@ Header for class which generates a depth pyramid (i.e. depth mipmaps) from a dep
 
     // Depth downsampling pipeline state.
     id<MTLComputePipelineState> _pipelineState;
+
+    // Per-mip views of recently used pyramid textures, oldest first.
+    //  Views retain their parent texture, so the cache holds a bounded number of textures.
+    NSMutableArray<id<MTLTexture>>*                 _cachedPyramidTextures;
+    NSMutableArray<NSArray<id<MTLTexture>>*>*       _cachedMipViews;
 }
 
 - (nonnull instancetype)initWithDevice:(nonnull id<MTLDevice>)device
@@ -30,11 +39,71 @@ Header for class which generates a depth pyramid (i.e. depth mipmaps) from a dep
     {
         _device = device;
         _pipelineState = newComputePipelineState(library, @"depthPyramid", @"DepthPyramidGeneration", nil);
+
+        _cachedPyramidTextures  = [NSMutableArray new];
+        _cachedMipViews         = [NSMutableArray new];
     }
 
     return self;
 }
 
+// Creates a single-level R32Float view of each mip of the pyramid texture.
++ (nonnull NSArray<id<MTLTexture>>*)newMipViewsForPyramidTexture:(nonnull id<MTLTexture>)pyramidTexture
+{
+    NSMutableArray<id<MTLTexture>>* mipViews = [NSMutableArray arrayWithCapacity:pyramidTexture.mipmapLevelCount];
+
+    for (uint i = 0; i < pyramidTexture.mipmapLevelCount; i++)
+    {
+        id<MTLTexture> mipView = [pyramidTexture newTextureViewWithPixelFormat:MTLPixelFormatR32Float
+                                                                   textureType:MTLTextureType2D
+                                                                        levels:NSMakeRange(i, 1)
+                                                                        slices:NSMakeRange(0, 1)];
+        mipView.label = [NSString stringWithFormat:@"PyramidMipLevel%d" , i];
+        [mipViews addObject:mipView];
+    }
+
+    return mipViews;
+}
+
+// Returns the per-mip views for the pyramid texture, reusing the views from earlier frames when possible.
+- (nonnull NSArray<id<MTLTexture>>*)mipViewsForPyramidTexture:(nonnull id<MTLTexture>)pyramidTexture
+{
+    NSUInteger cacheIndex = [_cachedPyramidTextures indexOfObjectIdenticalTo:pyramidTexture];
+    if(cacheIndex != NSNotFound)
+        return _cachedMipViews[cacheIndex];
+
+    NSArray<id<MTLTexture>>* mipViews = [AAPLDepthPyramid newMipViewsForPyramidTexture:pyramidTexture];
+
+    // Texture views, such as the per-frame shadow cascade slices, are recreated by
+    //  the caller every frame, so caching their mips would only evict useful entries.
+    if(pyramidTexture.parentTexture == nil)
+    {
+        if(_cachedPyramidTextures.count == MaxCachedPyramidTextures)
+        {
+            [_cachedPyramidTextures removeObjectAtIndex:0];
+            [_cachedMipViews removeObjectAtIndex:0];
+        }
+
+        [_cachedPyramidTextures addObject:pyramidTexture];
+        [_cachedMipViews addObject:mipViews];
+    }
+
+    return mipViews;
+}
+
+- (void)invalidateMipViewsForPyramidTexture:(_Nullable id<MTLTexture>)pyramidTexture
+{
+    if(pyramidTexture == nil)
+        return;
+
+    NSUInteger cacheIndex = [_cachedPyramidTextures indexOfObjectIdenticalTo:pyramidTexture];
+    if(cacheIndex != NSNotFound)
+    {
+        [_cachedPyramidTextures removeObjectAtIndex:cacheIndex];
+        [_cachedMipViews removeObjectAtIndex:cacheIndex];
+    }
+}
+
 - (void)generate:(id<MTLTexture>)pyramidTexture
     depthTexture:(id<MTLTexture>)depthTexture
        onEncoder:(nonnull id<MTLComputeCommandEncoder>)encoder
@@ -47,24 +116,19 @@ Header for class which generates a depth pyramid (i.e. depth mipmaps) from a dep
 
     [encoder setComputePipelineState:_pipelineState]; // `depthPyramid` kernel.
 
+    NSArray<id<MTLTexture>>* mipViews = [self mipViewsForPyramidTexture:pyramidTexture];
+
     id<MTLTexture> srcMip = depthTexture;
     uint startMip = 0;
     if(depthTexture == pyramidTexture)
     {
-        srcMip = [pyramidTexture newTextureViewWithPixelFormat:MTLPixelFormatR32Float
-                                                                  textureType:MTLTextureType2D
-                                                                       levels:NSMakeRange(0, 1)
-                                                                       slices:NSMakeRange(0, 1)];
+        srcMip = mipViews[0];
 
         startMip = 1; // Skip first mip
     }
     for (uint i = startMip; i < pyramidTexture.mipmapLevelCount; i++)
     {
-        id<MTLTexture> dstMip = [pyramidTexture newTextureViewWithPixelFormat:MTLPixelFormatR32Float
-                                                                  textureType:MTLTextureType2D
-                                                                       levels:NSMakeRange(i, 1)
-                                                                       slices:NSMakeRange(0, 1)];
-        dstMip.label = [NSString stringWithFormat:@"PyramidMipLevel%d" , i];
+        id<MTLTexture> dstMip = mipViews[i];
 
         [encoder setTexture:srcMip atIndex:0];
         [encoder setTexture:dstMip atIndex:1];
@@ -621,6 +621,7 @@ Implementation of class which renders meshes
                 indexBuffer:mesh.indices
                   chunkData:mesh.chunkData
           setMaterialOffset:pass != AAPLRenderPassDepth
+              cullBackFaces:(pass == AAPLRenderPassDepth || pass == AAPLRenderPassGBuffer || pass == AAPLRenderPassForward)
                materialSize:materialSize
                cameraParams:cameraParams
                   onEncoder:encoder];
@@ -668,50 +669,89 @@ Implementation of class which renders meshes
     }
 }
 
+// Returns true if every triangle in a chunk faces away from a camera at the specified position.
+static bool chunkIsBackFacing(const AAPLMeshChunk& chunk, simd::float3 cameraPosition)
+{
+    // The cone of normals in `normalDistribution` must be narrower than a hemisphere.
+    const float cosMaxPhi = chunk.normalDistribution.w;
+    const float axisLength = simd::length(chunk.normalDistribution.xyz);
+
+    if(cosMaxPhi <= 0.0f || axisLength == 0.0f)
+        return false;
+
+    const simd::float3 axis     = chunk.normalDistribution.xyz / axisLength;
+    const simd::float3 toChunk  = chunk.boundingSphere.center - cameraPosition;
+    const float sinMaxPhi       = sqrtf(1.0f - cosMaxPhi * cosMaxPhi);
+
+    return simd::dot(toChunk, axis) >= sinMaxPhi * simd::length(toChunk) + chunk.boundingSphere.radius;
+}
+
 -(void)drawSubMeshes:(const AAPLSubMesh*)meshes
                count:(NSUInteger)count
          indexBuffer:(id<MTLBuffer>)indexBuffer
            chunkData:(const AAPLMeshChunk*)chunkData
    setMaterialOffset:(BOOL)setMaterialOffset
+       cullBackFaces:(BOOL)cullBackFaces
         materialSize:(size_t)materialSize
         cameraParams:(AAPLCameraParams&)cameraParams
            onEncoder:(id<MTLRenderCommandEncoder>)renderEncoder
 {
+    // Cone culling needs a camera position, so it only applies to perspective projections.
+    const bool coneCulling              = cullBackFaces && cameraParams.projectionMatrix.columns[3][3] == 0.0f;
+    const simd::float3 cameraPosition   = cameraParams.invViewMatrix.columns[3].xyz;
+
     for (NSUInteger i = 0; i < count; ++i)
     {
         const AAPLSubMesh &mesh = meshes[i];
 
-        if(setMaterialOffset)
-            [renderEncoder setFragmentBufferOffset:mesh.materialIndex * materialSize atIndex:AAPLBufferIndexFragmentMaterial];
-
-#if 0 // one draw per chunk or full mesh
-        for (NSUInteger c = mesh.chunkStart; c < (mesh.chunkStart + mesh.chunkCount); ++c)
-        {
-            const AAPLMeshChunk &chunk = chunkData[c];
-
-            const bool frustumCulled = !sphereInFrustum(cameraParams, chunk.boundingSphere);
-
-            if (frustumCulled)
-                continue;
-
-            [renderEncoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle
-                                      indexCount:chunk.indexCount
-                                       indexType:MTLIndexTypeUInt32
-                                     indexBuffer:indexBuffer
-                               indexBufferOffset:chunk.indexBegin * sizeof(uint32_t)];
-        }
-#else
         const bool frustumCulled = !sphereInFrustum(cameraParams, mesh.boundingSphere);
 
         if (frustumCulled)
             continue;
 
-        [renderEncoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle
-                                  indexCount:mesh.indexCount
-                                   indexType:MTLIndexTypeUInt32
-                                 indexBuffer:indexBuffer
-                           indexBufferOffset:mesh.indexBegin * sizeof(uint32_t)];
-#endif
+        if(setMaterialOffset)
+            [renderEncoder setFragmentBufferOffset:mesh.materialIndex * materialSize atIndex:AAPLBufferIndexFragmentMaterial];
+
+        // Cull each chunk of a visible submesh, and merge runs of visible chunks whose indices
+        //  are adjacent in the index buffer into a single draw.
+        NSUInteger drawIndexBegin = 0;
+        NSUInteger drawIndexCount = 0;
+
+        for (NSUInteger c = mesh.chunkStart; c <= (mesh.chunkStart + mesh.chunkCount); ++c)
+        {
+            bool visible = false;
+
+            if(c < mesh.chunkStart + mesh.chunkCount)
+            {
+                const AAPLMeshChunk &chunk = chunkData[c];
+
+                visible = sphereInFrustum(cameraParams, chunk.boundingSphere)
+                          && !(coneCulling && chunkIsBackFacing(chunk, cameraPosition));
+
+                if(visible && drawIndexCount > 0 && chunk.indexBegin == drawIndexBegin + drawIndexCount)
+                {
+                    drawIndexCount += chunk.indexCount;
+                    continue;
+                }
+            }
+
+            // Flush the pending run when it ends, either at a culled chunk, a gap or the end of the submesh.
+            if(drawIndexCount > 0)
+            {
+                [renderEncoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                                          indexCount:drawIndexCount
+                                           indexType:MTLIndexTypeUInt32
+                                         indexBuffer:indexBuffer
+                                   indexBufferOffset:drawIndexBegin * sizeof(uint32_t)];
+                drawIndexCount = 0;
+            }
+
+            if(visible)
+            {
+                drawIndexBegin = chunkData[c].indexBegin;
+                drawIndexCount = chunkData[c].indexCount;
+            }
+        }
     }
 }
 
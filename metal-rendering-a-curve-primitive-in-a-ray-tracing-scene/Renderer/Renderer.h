@@ -12,4 +12,9 @@ The header for the renderer class that performs Metal setup and per-frame render
 
 - (instancetype)initWithDevice:(id<MTLDevice>)device;
 
+// The seed for the per-pixel random values that decorrelate the sample sequence.
+// Rendering with the same seed produces the same sequence of frames. Setting it
+// restarts accumulation.
+@property (nonatomic) uint32_t randomSeed;
+
 @end
@@ -17,6 +17,18 @@ using namespace simd;
 static const NSUInteger maxFramesInFlight = 3;
 static const size_t alignedUniformsSize = (sizeof(Uniforms) + 255) & ~255;
 
+// The default seed for the per-pixel random values.
+static const uint32_t defaultRandomSeed = 0x9E3779B9;
+
+// Hashes a pixel index and seed into a pseudorandom value. Unlike `rand()`, this
+// doesn't have any shared state, so each pixel's value depends only on the seed.
+static uint32_t randomValueForPixel(uint32_t pixelIndex, uint32_t seed)
+{
+    uint32_t state = (pixelIndex ^ seed) * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
 @implementation Renderer
 {
     id <MTLDevice> _device;
@@ -60,6 +72,7 @@ static const size_t alignedUniformsSize = (sizeof(Uniforms) + 255) & ~255;
     if (self)
     {
         _device = device;
+        _randomSeed = defaultRandomSeed;
         
         _sem = dispatch_semaphore_create(maxFramesInFlight);
         
@@ -417,10 +430,24 @@ static const size_t alignedUniformsSize = (sizeof(Uniforms) + 255) & ~255;
     for (NSUInteger i = 0; i < 2; i++)
         _accumulationTargets[i] = [_device newTextureWithDescriptor:textureDescriptor];
     
-    // Create a texture that contains a random integer value for each pixel. The sample
-    // uses these values to decorrelate pixels while drawing pseudorandom numbers from the
-    // Halton sequence.
-    textureDescriptor.pixelFormat = MTLPixelFormatR32Uint;
+    [self createRandomTexture];
+    
+    _frameIndex = 0;
+}
+
+// Create a texture that contains a random integer value for each pixel. The sample
+// uses these values to decorrelate pixels while drawing pseudorandom numbers from the
+// Halton sequence. The values depend only on `randomSeed`, so a given seed always
+// produces the same sequence of frames.
+- (void)createRandomTexture
+{
+    const NSUInteger width = (NSUInteger)_size.width;
+    const NSUInteger height = (NSUInteger)_size.height;
+    
+    MTLTextureDescriptor *textureDescriptor = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatR32Uint
+                                                                                                 width:width
+                                                                                                height:height
+                                                                                             mipmapped:NO];
     textureDescriptor.usage = MTLTextureUsageShaderRead;
     
     // The sample initializes the data in the texture, so it can't be private.
@@ -433,22 +460,35 @@ static const size_t alignedUniformsSize = (sizeof(Uniforms) + 255) & ~255;
     textureDescriptor.storageMode = MTLStorageModeShared;
 #endif
     
+    // Create a new texture rather than overwriting the current one, which frames still
+    // in flight may be reading.
     _randomTexture = [_device newTextureWithDescriptor:textureDescriptor];
     
     // Initialize the random values.
-    uint32_t *randomValues = (uint32_t *)malloc(sizeof(uint32_t) * size.width * size.height);
+    uint32_t *randomValues = (uint32_t *)malloc(sizeof(uint32_t) * width * height);
     
-    for (NSUInteger i = 0; i < size.width * size.height; i++)
-        randomValues[i] = rand() % (1024 * 1024);
+    for (NSUInteger i = 0; i < width * height; i++)
+        randomValues[i] = randomValueForPixel((uint32_t)i, _randomSeed) % (1024 * 1024);
     
-    [_randomTexture replaceRegion:MTLRegionMake2D(0, 0, size.width, size.height)
+    [_randomTexture replaceRegion:MTLRegionMake2D(0, 0, width, height)
                       mipmapLevel:0
                         withBytes:randomValues
-                      bytesPerRow:sizeof(uint32_t) * size.width];
+                      bytesPerRow:sizeof(uint32_t) * width];
     
     free(randomValues);
+}
+
+- (void)setRandomSeed:(uint32_t)randomSeed
+{
+    _randomSeed = randomSeed;
     
-    _frameIndex = 0;
+    // Regenerate the random values and restart accumulation so the image only
+    // contains samples from the new seed.
+    if (_randomTexture)
+    {
+        [self createRandomTexture];
+        _frameIndex = 0;
+    }
 }
 
 - (void)updateUniforms {
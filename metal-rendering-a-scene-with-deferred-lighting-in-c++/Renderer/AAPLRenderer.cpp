@@ -44,9 +44,13 @@ static const uint32_t TreeLights   = 0            + 0.30 * NumLights;
 static const uint32_t GroundLights = TreeLights   + 0.40 * NumLights;
 static const uint32_t ColumnLights = GroundLights + 0.30 * NumLights;
 
+// Tree lights and orbiting lights animate differently, so each group starts at a new animation block
+static const uint32_t TreeLightBlocks  = (TreeLights + LightsPerAnimationBlock - 1) / LightsPerAnimationBlock;
+static const uint32_t OrbitLightBlocks = (NumLights - TreeLights + LightsPerAnimationBlock - 1) / LightsPerAnimationBlock;
+
 Renderer::Renderer( MTL::Device* pDevice )
 : m_pDevice( pDevice->retain() )
-, m_originalLightPositions(nullptr)
+, m_lightAnimation(nullptr)
 , m_frameDataBufferIndex(0)
 , m_frameNumber(0)
 #if SUPPORT_BUFFER_EXAMINATION
@@ -94,7 +98,7 @@ Renderer::~Renderer()
     m_pCommandQueue->release();
     m_pDevice->release();
     
-    delete [] m_originalLightPositions;
+    delete [] m_lightAnimation;
 }
 
 /// Create Metal render state objects
@@ -647,9 +651,7 @@ void Renderer::populateLights()
 {
     PointLight *light_data = (PointLight*)m_pLightsData->contents();
 
-    m_originalLightPositions = new float4[ NumLights ];
-
-    float4 *light_position = m_originalLightPositions;
+    m_lightAnimation = new LightAnimationBlock[ TreeLightBlocks + OrbitLightBlocks ]();
 
     srandom(0x134e5348);
 
@@ -685,7 +687,16 @@ void Renderer::populateLights()
         }
 
         speed *= .5;
-        *light_position = (float4){ distance*sinf(angle),height,distance*cosf(angle),1};
+
+        uint32_t groupIndex = lightId < TreeLights ? lightId : lightId - TreeLights;
+        uint32_t blockIndex = groupIndex / LightsPerAnimationBlock + (lightId < TreeLights ? 0 : TreeLightBlocks);
+        uint32_t lane = groupIndex % LightsPerAnimationBlock;
+        LightAnimationBlock &animation = m_lightAnimation[blockIndex];
+        animation.distance[lane] = distance;
+        animation.height[lane] = height;
+        animation.angle[lane] = angle;
+        animation.speed[lane] = speed;
+
         light_data->light_radius = random_float(25,35)/10.0;
         light_data->light_speed  = speed;
 
@@ -699,47 +710,65 @@ void Renderer::populateLights()
         }
 
         light_data++;
-        light_position++;
+    }
+}
+
+/// Transform the positions of up to LightsPerAnimationBlock lights and write them to the light position buffer
+static void storeLightPositions(const float4x4 & modelViewMatrix,
+                                const float8 & x, const float8 & y, const float8 & z,
+                                float4 *lightPositions, uint32_t count)
+{
+    const float4x4 &m = modelViewMatrix;
+    float8 tx = m.columns[0].x * x + m.columns[1].x * y + m.columns[2].x * z + m.columns[3].x;
+    float8 ty = m.columns[0].y * x + m.columns[1].y * y + m.columns[2].y * z + m.columns[3].y;
+    float8 tz = m.columns[0].z * x + m.columns[1].z * y + m.columns[2].z * z + m.columns[3].z;
+    float8 tw = m.columns[0].w * x + m.columns[1].w * y + m.columns[2].w * z + m.columns[3].w;
+
+    for(uint32_t lane = 0; lane < count; lane++)
+    {
+        lightPositions[lane] = (float4){ tx[lane], ty[lane], tz[lane], tw[lane] };
     }
 }
 
 /// Update light positions
 void Renderer::updateLights(const float4x4 & modelViewMatrix)
 {
-    PointLight *lightData = (PointLight*)m_pLightsData->contents();
-
     float4 *currentBuffer =
         (float4*) m_lightPositions[m_frameDataBufferIndex]->contents();
 
-    float4 *originalLightPositions =  (float4 *)m_originalLightPositions;
+    const LightAnimationBlock *animation = m_lightAnimation;
 
-    for(int i = 0; i < NumLights; i++)
+    for(uint32_t block = 0; block < TreeLightBlocks; block++, animation++)
     {
-        float4 currentPosition;
-
-        if(i < TreeLights)
-        {
-            double lightPeriod = lightData[i].light_speed  * m_frameNumber;
-            lightPeriod += originalLightPositions[i].y;
-            lightPeriod -= floor(lightPeriod);  // Get fractional part
+        uint32_t firstLight = block * LightsPerAnimationBlock;
+        uint32_t count = std::min(LightsPerAnimationBlock, TreeLights - firstLight);
+
+        // Tree lights rise along the trunk, with the height as the phase of the cycle
+        double8 lightPeriod = simd_double(animation->speed) * (double)m_frameNumber + simd_double(animation->height);
+        lightPeriod -= floor(lightPeriod);  // Get fractional part
+        float8 period = simd_float(lightPeriod);
+
+        // Slowly move the light outward as it reaches the branches of the tree
+        float8 period2 = period * period;
+        float8 r = 1.2f + 10.0f * period2 * period2 * period;
+
+        float8 x = animation->distance * sin(animation->angle) * r;
+        float8 y = 200.0f + period * 400.0f;
+        float8 z = animation->distance * cos(animation->angle) * r;
+        storeLightPositions(modelViewMatrix, x, y, z, currentBuffer + firstLight, count);
+    }
 
-            // Use pow to slowly move the light outward as it reaches the branches of the tree
-            float r = 1.2 + 10.0 * powf(lightPeriod, 5.0);
+    for(uint32_t block = 0; block < OrbitLightBlocks; block++, animation++)
+    {
+        uint32_t firstLight = TreeLights + block * LightsPerAnimationBlock;
+        uint32_t count = std::min(LightsPerAnimationBlock, NumLights - firstLight);
 
-            currentPosition.x = originalLightPositions[i].x * r;
-            currentPosition.y = 200.0f + lightPeriod * 400.0f;
-            currentPosition.z = originalLightPositions[i].z * r;
-            currentPosition.w = 1;
-        }
-        else
-        {
-            float rotationRadians = lightData[i].light_speed * m_frameNumber;
-            float4x4 rotation = matrix4x4_rotation(rotationRadians, 0, 1, 0);
-            currentPosition = rotation * originalLightPositions[i];
-        }
+        // Rotating a light about the y axis advances its angle around the orbit
+        float8 angle = animation->angle + animation->speed * (float)m_frameNumber;
 
-        currentPosition = modelViewMatrix * currentPosition;
-        currentBuffer[i] = currentPosition;
+        float8 x = animation->distance * sin(angle);
+        float8 z = animation->distance * cos(angle);
+        storeLightPositions(modelViewMatrix, x, animation->height, z, currentBuffer + firstLight, count);
     }
 }
 
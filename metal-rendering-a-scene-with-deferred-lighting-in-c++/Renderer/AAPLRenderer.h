@@ -19,6 +19,18 @@ constexpr uint8_t MaxFramesInFlight = 3;
 // Number of "fairy" lights in scene
 static const uint32_t NumLights = 256;
 
+// Number of lights whose animation parameters share a SIMD vector
+static const uint32_t LightsPerAnimationBlock = 8;
+
+// Animation parameters of LightsPerAnimationBlock lights in structure-of-arrays form
+struct LightAnimationBlock
+{
+    simd::float8 distance;
+    simd::float8 height;
+    simd::float8 angle;
+    simd::float8 speed;
+};
+
 static const float NearPlane = 1;
 static const float FarPlane = 150;
 
@@ -204,8 +216,8 @@ private:
     // Vertex descriptor for models loaded with MetalKit
     MTL::VertexDescriptor* m_pSkyVertexDescriptor;
 
-    // Light positions before transformation to positions in current frame
-    simd::float4 *m_originalLightPositions;
+    // Light animation parameters from which each frame's light positions are computed
+    LightAnimationBlock *m_lightAnimation;
     // Mesh for an icosahedron used for rendering point lights
     Mesh m_icosahedronMesh;
 
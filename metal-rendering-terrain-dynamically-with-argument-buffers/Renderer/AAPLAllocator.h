@@ -13,6 +13,7 @@ Declaration of the AAPLAllocator and AAPLGpuBuffer class.
 
 #import <Foundation/Foundation.h>
 #import <vector>
+#import <atomic>
 #import <simd/simd.h>
 #import <Metal/Metal.h>
 
@@ -65,7 +66,8 @@ private:
     // ARC automatically makes these references strong
     std::vector <id <MTLBuffer>>    buffers;
     uint8_t                         currentBufferIdx;
-    size_t                          currentlyAllocated;
+    // Atomic so that several encoding threads can allocate without a lock
+    std::atomic <size_t>            currentlyAllocated;
     bool                            isFrozen;
 };
 
@@ -101,17 +103,26 @@ AAPLGpuBuffer <TElement> AAPLAllocator::allocBuffer (uint inElementCount)
 #endif
     assert (alignment >= alignof(TElement));
 
-    size_t offset = (currentlyAllocated + alignment - 1) & ~(alignment - 1);
-    size_t size = sizeof(TElement) * inElementCount;
-    if (offset + size > buffers[0].length)
+    const size_t size = sizeof(TElement) * inElementCount;
+    const size_t capacity = buffers[0].length;
+
+    // Bump the shared offset; on contention, retry from the offset another thread left
+    size_t allocated = currentlyAllocated.load (std::memory_order_relaxed);
+    size_t offset;
+    do
     {
-        assert (false);
-        NSException* oom = [NSException
-                            exceptionWithName:@"OutOfMemory"
-                            reason:@"Not enough space in the Metal buffer allocator to create a new Buffer."
-                            userInfo:nil];
-        @throw oom;
+        offset = (allocated + alignment - 1) & ~(alignment - 1);
+        if (offset + size > capacity)
+        {
+            assert (false);
+            NSException* oom = [NSException
+                                exceptionWithName:@"OutOfMemory"
+                                reason:@"Not enough space in the Metal buffer allocator to create a new Buffer."
+                                userInfo:nil];
+            @throw oom;
+        }
     }
-    currentlyAllocated = offset + size;
+    while (!currentlyAllocated.compare_exchange_weak (allocated, offset + size, std::memory_order_relaxed));
+
     return AAPLGpuBuffer <TElement> (this, offset, size);
 }
@@ -15,7 +15,8 @@ isFrozen (false)
     assert (ringSize > 0);
     for (uint8_t i = 0; i < ringSize; i++)
     {
-        buffers.push_back ([device newBufferWithLength:size options:MTLResourceOptionCPUCacheModeDefault]);
+        // The CPU only ever writes to these buffers, so write-combined memory avoids polluting the CPU caches
+        buffers.push_back ([device newBufferWithLength:size options:MTLResourceCPUCacheModeWriteCombined]);
     }
 }
 
@@ -35,7 +36,7 @@ void AAPLAllocator::freezeNonRingBuffer()
         assert (false);
         return;
     }
-    assert(currentlyAllocated > 0);
+    assert(currentlyAllocated.load() > 0);
     isFrozen = true;
 }
 
@@ -31,6 +31,7 @@ template<> struct std::hash<AAPLObjVertex>
 @property float          boundingRadius;
 @property id <MTLBuffer> vertexBuffer;
 @property id <MTLBuffer> indexBuffer;
+@property MTLIndexType   indexType;
 
 - (NSUInteger)indexCount;
 - (NSUInteger)vertexCount;
@@ -7,11 +7,13 @@ Implementation of the AAPLObjLoader.
 */
 
 #import "AAPLObjLoader.h"
-#include <stdio.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string>
 
 @implementation AAPLObjMesh
 - (NSUInteger)vertexCount { return _vertexBuffer.length / sizeof(AAPLObjVertex); }
-- (NSUInteger)indexCount { return _indexBuffer.length / sizeof(uint16_t); }
+- (NSUInteger)indexCount { return _indexBuffer.length / (_indexType == MTLIndexTypeUInt16 ? sizeof(uint16_t) : sizeof(uint32_t)); }
 @end
 
 @implementation AAPLObjLoader
@@ -27,12 +29,9 @@ Implementation of the AAPLObjLoader.
 
     id <MTLDevice>                               _device;
     std::vector<AAPLObjVertex>                  _vertices;
-    std::vector<uint16_t>                       _indices;
+    std::vector<uint32_t>                       _indices;
 }
 
-// Buffer size used to store file data internally during read operations
-static constexpr uint kBufferSize = 2048;
-
 - (instancetype)initWithDevice:(id <MTLDevice>)device
 {
     self = [super init];
@@ -73,22 +72,95 @@ static constexpr uint kBufferSize = 2048;
     }
 }
 
-- (void)readLine:(NSData*)inLine lineNumber:(uint)inNumber
+// Skip spaces and tabs, and check that a field starts before the end of the line.
+// strtof and strtoul skip any leading whitespace, including newlines, so only call
+// them once the cursor is on a non-whitespace character inside the line
+static bool startField(const char*& cursor, const char* lineEnd)
+{
+    while (cursor < lineEnd && (*cursor == ' ' || *cursor == '\t'))
+        cursor++;
+    return cursor < lineEnd && !isspace((unsigned char)*cursor);
+}
+
+// Parse `count` whitespace-separated floats at the cursor and advance past them
+static bool parseFloats(const char*& cursor, const char* lineEnd, float* values, uint count)
+{
+    for (uint i = 0; i < count; i++)
+    {
+        if (!startField(cursor, lineEnd))
+            return false;
+        char* end;
+        values[i] = strtof(cursor, &end);
+        if (end == cursor)
+            return false;
+        cursor = end;
+    }
+    return true;
+}
+
+// Parse one "position/texcoord/normal" face vertex at the cursor and advance past it
+static bool parseFaceVertex(const char*& cursor, const char* lineEnd, uint& iv, uint& ivt, uint& ivn)
+{
+    if (!startField(cursor, lineEnd))
+        return false;
+
+    uint* indices[3] = { &iv, &ivt, &ivn };
+    for (uint i = 0; i < 3; i++)
+    {
+        // Each index must start with a digit, so strtoul never skips whitespace past the line end
+        if (cursor >= lineEnd || !isdigit((unsigned char)*cursor))
+            return false;
+        char* end;
+        *indices[i] = (uint)strtoul(cursor, &end, 10);
+        if (end == cursor || (i < 2 && *end != '/'))
+            return false;
+        cursor = (i < 2) ? end + 1 : end;
+    }
+    return true;
+}
+
+// Parse a single line of the file; `inLine` points at the first character and `lineEnd` at the newline or null character that ends it
+- (void)readLine:(const char*)inLine end:(const char*)lineEnd
 {
-    float x = 0.0f;
-    float y = 0.0f;
-    float z = 0.0f;
+    float values[3];
     uint iv[4];
     uint ivn[4];
     uint ivt[4];
 
-    if      (sscanf(((char*)inLine.bytes), "v %f %f %f", &x, &y, &z) == 3)  _positions.push_back( (simd::float3) {x,y,z} );
-    else if (sscanf(((char*)inLine.bytes), "vt %f %f %f", &x, &y, &z) == 3) _colors.push_back( (simd::float3) {x,y,z} );
-    else if (sscanf(((char*)inLine.bytes), "vn %f %f %f", &x, &y, &z) == 3) _normals.push_back( (simd::float3) {x,y,z} );
-    else if (sscanf(((char*)inLine.bytes), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d", &iv[0], &ivt[0], &ivn[0], &iv[1], &ivt[1], &ivn[1], &iv[2], &ivt[2], &ivn[2], &iv[3], &ivt[3], &ivn[3]) == 12) // quad
+    const char* cursor = inLine + 2;
+
+    if (inLine[0] == 'v' && inLine[1] == ' ')
+    {
+        if (parseFloats(cursor, lineEnd, values, 3)) _positions.push_back( (simd::float3) {values[0],values[1],values[2]} );
+    }
+    else if (inLine[0] == 'v' && inLine[1] == 't')
     {
+        cursor++;
+        if (parseFloats(cursor, lineEnd, values, 3)) _colors.push_back( (simd::float3) {values[0],values[1],values[2]} );
+    }
+    else if (inLine[0] == 'v' && inLine[1] == 'n')
+    {
+        cursor++;
+        if (parseFloats(cursor, lineEnd, values, 3)) _normals.push_back( (simd::float3) {values[0],values[1],values[2]} );
+    }
+    else if (inLine[0] == 'f' && inLine[1] == ' ')
+    {
+        // Read a triangle, then check for a fourth vertex that makes the face a quad
+        uint vertexCount = 0;
+        while (vertexCount < 4 && parseFaceVertex(cursor, lineEnd, iv[vertexCount], ivt[vertexCount], ivn[vertexCount]))
+            vertexCount++;
+        if (vertexCount < 3)
+            return;
+
+        // Skip faces that reference attributes the file hasn't declared, before adding any of their vertices
+        for (uint v = 0; v < vertexCount; v++)
+        {
+            if (iv[v] - 1 >= _positions.size() || ivn[v] - 1 >= _normals.size() || ivt[v] - 1 >= _colors.size())
+                return;
+        }
+
         uint indices[4];
-        for (uint v = 0; v < 4; v++)
+        for (uint v = 0; v < vertexCount; v++)
         {
             AAPLObjVertex vtx;
             vtx.position      = _positions[iv[v]-1];
@@ -99,24 +171,12 @@ static constexpr uint kBufferSize = 2048;
         _indices.push_back(indices[0]);
         _indices.push_back(indices[1]);
         _indices.push_back(indices[2]);
-        _indices.push_back(indices[0]);
-        _indices.push_back(indices[2]);
-        _indices.push_back(indices[3]);
-    }
-    else if (sscanf(((char*)inLine.bytes), "f %d/%d/%d %d/%d/%d %d/%d/%d", &iv[0], &ivt[0], &ivn[0], &iv[1], &ivt[1], &ivn[1], &iv[2], &ivt[2], &ivn[2]) == 9) // triangle
-    {
-        uint indices[3];
-        for (uint v = 0; v < 3; v++)
+        if (vertexCount == 4)
         {
-            AAPLObjVertex vtx;
-            vtx.position      = _positions[iv[v]-1];
-            vtx.normal        = _normals[ivn[v]-1];
-            vtx.color         = _colors[ivt[v]-1];
-            indices[v]        = [self createOrFindVertex:vtx];
+            _indices.push_back(indices[0]);
+            _indices.push_back(indices[2]);
+            _indices.push_back(indices[3]);
         }
-        _indices.push_back(indices[0]);
-        _indices.push_back(indices[1]);
-        _indices.push_back(indices[2]);
     }
 }
 
@@ -125,48 +185,35 @@ static constexpr uint kBufferSize = 2048;
 {
     [self clear];
 
-    NSInputStream* is = [NSInputStream inputStreamWithURL:inUrl];
-    assert(is != nil);
-    [is open];
-
-    uint8_t read_buffer[kBufferSize];
+    // Map the file and parse the lines in place instead of copying each one out of a stream
+    NSError* error = nil;
+    NSData* fileData = [NSData dataWithContentsOfURL:inUrl options:NSDataReadingMappedIfSafe error:&error];
+    assert(fileData != nil);
 
-    // Begin of current line(part) within buffer
-    uint8_t* begin_line         = read_buffer;
+    const char* begin_line = (const char*)fileData.bytes;
+    const char* end_buffer = begin_line + fileData.length;
 
-    // End of current line(part) within buffer
-    uint8_t* end_line           = read_buffer;
-
-    // End of valid data in the buffer
-    uint8_t* end_buffer         = read_buffer;
-    NSMutableData* line         = [NSMutableData data];
-    uint lineNumber             = 0;
-
-    // Run until we run out of buffer and the input stream has no more data to retrieve
-    while(begin_line != end_buffer || [is hasBytesAvailable])
+    // Run until we run out of lines
+    while (begin_line < end_buffer)
     {
-        // Scan to end of buffer/end of line
-        for (end_line = begin_line; (end_line < end_buffer) && (*end_line != '\n'); end_line++) {}
-
-        // Append part of c-style string to line buffer
-        [line appendBytes: begin_line length:end_line-begin_line];
+        const char* end_line = (const char*)memchr(begin_line, '\n', end_buffer - begin_line);
 
-        if (end_line == end_buffer)
+        if (end_line)
         {
-            // In case of out-of-buffer, read new data, reset buffer
-            end_buffer = read_buffer + [is read:&read_buffer[0] maxLength:kBufferSize-1];
-            begin_line = read_buffer;
+            // The parsers never read past the line end, so lines can be parsed from the file data directly
+            if (end_line - begin_line >= 2)
+                [self readLine:begin_line end:end_line];
+            begin_line = end_line + 1;
         }
         else
         {
-            // In case of end-of-line, push new line, reset line buffer
-            [line appendBytes:"" length:1];
-            [self readLine: line lineNumber:++lineNumber];
-            [line setLength:0];
-            begin_line = end_line+1;
+            // The last line has no newline, so parse a null-terminated copy of it
+            std::string last_line(begin_line, end_buffer);
+            if (last_line.size() >= 2)
+                [self readLine:last_line.c_str() end:last_line.c_str() + last_line.size()];
+            begin_line = end_buffer;
         }
     }
-    [is close];
 
     AAPLObjMesh* new_mesh = [[AAPLObjMesh alloc] init];
 
@@ -176,9 +223,14 @@ static constexpr uint kBufferSize = 2048;
     const MTLResourceOptions storageMode = MTLResourceStorageModeManaged;
 #endif
 
+    // Use 16-bit indices when every vertex is addressable with them, and 32-bit indices otherwise
+    const bool useShortIndices = _vertices.size() <= UINT16_MAX + 1;
+    const size_t indexSize = useShortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
     // Generate buffers
     new_mesh.vertexBuffer =     [_device newBufferWithLength:(sizeof(AAPLObjVertex)*_vertices.size())         options:storageMode];
-    new_mesh.indexBuffer =      [_device newBufferWithLength:(sizeof(uint16_t)*_indices.size())               options:storageMode];
+    new_mesh.indexBuffer =      [_device newBufferWithLength:(indexSize*_indices.size())                      options:storageMode];
+    new_mesh.indexType =        useShortIndices ? MTLIndexTypeUInt16 : MTLIndexTypeUInt32;
     new_mesh.boundingRadius = _boundingSphereRadius;
 
     // Copy vertices
@@ -188,7 +240,16 @@ static constexpr uint kBufferSize = 2048;
 #endif
 
     // Copy indices
-    memcpy(new_mesh.indexBuffer.contents, _indices.data(), sizeof(uint16_t) * _indices.size());
+    if (useShortIndices)
+    {
+        uint16_t* shortIndices = (uint16_t*)new_mesh.indexBuffer.contents;
+        for (size_t i = 0; i < _indices.size(); i++)
+            shortIndices[i] = (uint16_t)_indices[i];
+    }
+    else
+    {
+        memcpy(new_mesh.indexBuffer.contents, _indices.data(), sizeof(uint32_t) * _indices.size());
+    }
 #if TARGET_OS_OSX
     [new_mesh.indexBuffer didModifyRange:NSMakeRange(0, new_mesh.indexBuffer.length)];
 #endif
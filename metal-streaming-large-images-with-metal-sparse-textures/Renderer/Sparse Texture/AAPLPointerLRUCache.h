@@ -6,80 +6,165 @@ The header for the class that manages the least-recently used list of pointers.
 */
 #pragma once
 
-#include <list>
+#include <cstdint>
 #include <unordered_map>
+#include <vector>
 
 /// AAPLPointerLRUCache manages the least-recently used list of pointers.
+///
+/// The list links nodes by index in a pool that reuses the slots of discarded pointers,
+/// so after the cache reaches its working size, adding a pointer doesn't allocate.
 template <typename PointerType>
 class AAPLPointerLRUCache
 {
 public:
     AAPLPointerLRUCache() {}
-    
+
     ~AAPLPointerLRUCache()
     {
-        _lru.clear();
+        _nodes.clear();
         _lruNodes.clear();
     }
-    
+
+    /// Preallocates storage for the given number of pointers.
+    void reserve(size_t capacity)
+    {
+        _nodes.reserve(capacity);
+        _lruNodes.reserve(capacity);
+    }
+
     /// Gets the pointer (if it exists) from the cache and moves it to the front of the LRU cache.
     PointerType get(PointerType dataPtr)
     {
         auto nodeIter = _lruNodes.find(dataPtr);
         if (nodeIter == _lruNodes.end())
             return nullptr;
-        moveDataNodeToHead(nodeIter->second);
-        return *(nodeIter->second);
+        moveNodeToHead(nodeIter->second);
+        return _nodes[nodeIter->second].dataPtr;
     }
-    
+
     /// Adds the pointer to the LRU cache.
     void put(PointerType dataPtr)
     {
-        if (_lruNodes.count(dataPtr))
+        auto inserted = _lruNodes.emplace(dataPtr, InvalidNode);
+        if (!inserted.second)
             return;
-        _lru.push_front(dataPtr);
-        _lruNodes[dataPtr] = _lru.begin();
+
+        uint32_t node;
+        if (_freeHead != InvalidNode)
+        {
+            node      = _freeHead;
+            _freeHead = _nodes[node].next;
+        }
+        else
+        {
+            node = (uint32_t)_nodes.size();
+            _nodes.emplace_back();
+        }
+
+        _nodes[node].dataPtr = dataPtr;
+        inserted.first->second = node;
+        linkAtHead(node);
     }
-    
+
     /// Returns and removes the least recently used element from the LRU cache.
     PointerType discardLeastRecentlyUsed()
     {
-        if (_lru.empty())
+        if (_tail == InvalidNode)
             return nullptr;
-        PointerType dataPtr = _lru.back();
-        _lru.pop_back();
+        PointerType dataPtr = _nodes[_tail].dataPtr;
         _lruNodes.erase(dataPtr);
+        releaseNode(_tail);
         return dataPtr;
     }
-    
+
+    /// Removes up to `count` of the least recently used elements from the LRU cache,
+    /// appending them to `discarded` from oldest to newest, and returns the number removed.
+    size_t discardLeastRecentlyUsed(size_t count, std::vector<PointerType>& discarded)
+    {
+        size_t numDiscarded = 0;
+        for (; numDiscarded < count && _tail != InvalidNode; ++numDiscarded)
+        {
+            discarded.push_back(discardLeastRecentlyUsed());
+        }
+        return numDiscarded;
+    }
+
     /// Discards the pointer from the LRU cache.
     void discard(PointerType dataPtr)
     {
-        if (_lru.empty())
-            return;
         auto nodeIter = _lruNodes.find(dataPtr);
         if (nodeIter == _lruNodes.end())
             return;
-        _lru.erase(nodeIter->second);
+        releaseNode(nodeIter->second);
         _lruNodes.erase(nodeIter);
     }
-    
+
     /// Returns the size of the cache.
     size_t size() const
     {
         return _lruNodes.size();
     }
-    
+
 private:
-    using NodeIter = typename std::list<PointerType>::iterator;
+    static constexpr uint32_t InvalidNode = UINT32_MAX;
+
+    struct Node
+    {
+        PointerType dataPtr = nullptr;
+        uint32_t    prev    = InvalidNode;
+        uint32_t    next    = InvalidNode;
+    };
+
+    /// The node pool. Free nodes form a singly linked list through `next`.
+    std::vector<Node> _nodes;
+    std::unordered_map<PointerType, uint32_t> _lruNodes;
+
+    uint32_t _head     = InvalidNode;
+    uint32_t _tail     = InvalidNode;
+    uint32_t _freeHead = InvalidNode;
+
+    /// Inserts an unlinked node at the front of the list.
+    void linkAtHead(uint32_t node)
+    {
+        _nodes[node].prev = InvalidNode;
+        _nodes[node].next = _head;
+        if (_head != InvalidNode)
+            _nodes[_head].prev = node;
+        else
+            _tail = node;
+        _head = node;
+    }
 
-    std::list<PointerType> _lru;
-    std::unordered_map<PointerType, NodeIter> _lruNodes;
-    
-    /// Moves nodeIter to the front of the list.
-    void moveNodeToHead(NodeIter nodeIter)
+    /// Removes a node from the list without freeing it.
+    void unlink(uint32_t node)
     {
-        _lru.push_front(*nodeIter);
-        _lru.erase(nodeIter);
+        const Node& n = _nodes[node];
+        if (n.prev != InvalidNode)
+            _nodes[n.prev].next = n.next;
+        else
+            _head = n.next;
+        if (n.next != InvalidNode)
+            _nodes[n.next].prev = n.prev;
+        else
+            _tail = n.prev;
+    }
+
+    /// Removes a node from the list and returns it to the pool.
+    void releaseNode(uint32_t node)
+    {
+        unlink(node);
+        _nodes[node].dataPtr = nullptr;
+        _nodes[node].next    = _freeHead;
+        _freeHead            = node;
+    }
+
+    /// Moves the node to the front of the list.
+    void moveNodeToHead(uint32_t node)
+    {
+        if (node == _head)
+            return;
+        unlink(node);
+        linkAtHead(node);
     }
 };
@@ -16,6 +16,9 @@ The implementation of the class that streams a sparse texture.
 #import <mutex>
 #import <thread>
 
+#import <sys/mman.h>
+#import <unistd.h>
+
 #pragma mark - Helper Functions
 //------------------------------------------------------------------//
 
@@ -63,6 +66,27 @@ static void copyTileRegionBlockTexture(uint8_t* sourceData, id<MTLBuffer> outBuf
     }
 }
 
+/// Ask the kernel to start reading the file pages that hold a tile region of block-compressed texture data.
+/// The rows of a tile are far apart in the file, so without this hint each row faults in its page in turn during the copy.
+static void prefetchTileRegionBlockTexture(const uint8_t* sourceData, MTLSize sourceTextureSize, MTLOrigin copyOrigin, MTLSize destSize, NSUInteger blocksSize)
+{
+    static const uintptr_t pageMask = (uintptr_t)getpagesize() - 1;
+
+    MTLOrigin blockCopyOrigin = MTLOriginMake(copyOrigin.x, copyOrigin.y / blocksSize, copyOrigin.z);
+
+    NSUInteger totalDestWidth = destSize.width * blocksSize;
+    NSUInteger sourceYLimit   = blockCopyOrigin.y + (destSize.height / blocksSize);
+    NSUInteger sourceXOffset  = blockCopyOrigin.x * blocksSize;
+    NSUInteger sourceYOffset  = sourceTextureSize.width * blocksSize;
+
+    for (NSUInteger sourceY = blockCopyOrigin.y; sourceY < sourceYLimit; ++sourceY)
+    {
+        uintptr_t rowBegin = (uintptr_t)(sourceData + sourceXOffset + (sourceY * sourceYOffset));
+        uintptr_t pageBegin = rowBegin & ~pageMask;
+        madvise((void*)pageBegin, rowBegin + totalDestWidth - pageBegin, MADV_WILLNEED);
+    }
+}
+
 #pragma mark - Declarations
 //------------------------------------------------------------------//
 
@@ -150,6 +174,8 @@ struct TextureTile
     std::vector<TextureTile*> _unmapTilesRequest;
     // Holds the current map tile request list.
     std::vector<TextureTile*> _mapTilesRequest;
+    // Holds the tiles the current update discards from the LRU cache.
+    std::vector<TextureTile*> _discardedTiles;
 
     // Update mutex to allow only one update at a time.
     std::mutex _updateMutex;
@@ -321,6 +347,25 @@ struct TextureTile
     _unmapTilesRequest.push_back(tile);
 }
 
+/// Start reading the file data for all the tiles in a batch before copying any of them,
+/// so the reads overlap instead of blocking on each tile in turn.
+- (void)prefetchTiles:(const std::vector<TextureTile*>&)tiles
+{
+    for (const TextureTile* tile : tiles)
+    {
+        MTLSize sourceTextureSize = [_sparseTextureBacking calculateMipmapRegion:tile->origin.z].size;
+        NSUInteger mipDataOffset  = _sparseTextureBacking.mipmapOffsets[tile->origin.z];
+        MTLOrigin copyOrigin = MTLOriginMake(tile->origin.x * _tileSize.width,
+                                             tile->origin.y * _tileSize.height,
+                                             tile->origin.z);
+        prefetchTileRegionBlockTexture((const uint8_t *)_sparseTextureBacking.textureData.bytes + mipDataOffset,
+                                       sourceTextureSize,
+                                       copyOrigin,
+                                       _tileSize,
+                                       _sparseTextureBacking.blockSize);
+    }
+}
+
 /// Create a shared temporary buffer to stage a buffer copy later.
 /// The main functionality is to copy texture data from main memory to shared temp buffer.
 - (id<MTLBuffer>)streamTileToStagingBuffer:(TextureTile*)tile
@@ -470,14 +515,11 @@ struct TextureTile
     if (_numTilesToDiscardFromLRU == 0)
         return;
     
-    NSUInteger index = 0;
-    for (; index < _numTilesToDiscardFromLRU; ++index)
+    // Evict all the tiles the update needs in one call, oldest first.
+    _discardedTiles.clear();
+    NSUInteger index = (NSUInteger)_notUsedMappedTilesLRUCache.discardLeastRecentlyUsed(_numTilesToDiscardFromLRU, _discardedTiles);
+    for (TextureTile* tile : _discardedTiles)
     {
-        TextureTile* tile = _notUsedMappedTilesLRUCache.discardLeastRecentlyUsed();
-        if (!tile)
-        {
-            break;
-        }
         [self newUnmapTileRequest:tile];
     }
     
@@ -539,6 +581,8 @@ struct TextureTile
         id<MTLBlitCommandEncoder> blitEncoder = [cmdBuffer blitCommandEncoder];
         blitEncoder.label = @"Tile mapping blit encoder";
 
+        [self prefetchTiles:mapTilesRequest];
+
         // Stream the tiles from the source texture file into the sparse texture heap tiles.
         for (const auto& tile: mapTilesRequest)
         {
@@ -621,6 +665,9 @@ struct TextureTile
         _sparseTextureHeap                = [_device newHeapWithDescriptor:heapDescriptor];
         _sparseTextureHeap.label          = @"Sparse texture heap";
         NSAssert(_sparseTextureHeap, @"Failed to create the sparse texture heap.");
+
+        // The heap bounds the number of mapped tiles, so the LRU cache never grows past this.
+        _notUsedMappedTilesLRUCache.reserve(alignedHeapSize / _sparseTileSizeInBytes);
     }
     
     // Create a heap for temporary buffers used for blitting data to tiles in the sparse texture heap.
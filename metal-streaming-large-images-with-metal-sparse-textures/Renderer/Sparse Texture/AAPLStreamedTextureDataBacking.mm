@@ -31,6 +31,8 @@ typedef struct
 @implementation AAPLStreamedTextureDataBacking
 {
     KTXTexHeader* _header;
+    // The length of the file mapping that starts at `_header`.
+    size_t        _mappedLength;
 }
 
 /// Initialize the data backing using a KTX-formatted texture file data.
@@ -48,6 +50,11 @@ typedef struct
 {
     free(_mipmapOffsets);
     free(_mipmapLengths);
+
+    if (_header)
+    {
+        munmap(_header, _mappedLength);
+    }
 }
 
 /// Return the texture region based on its mipmap level.
@@ -93,8 +100,8 @@ typedef struct
         totalLength             = totalLength + currentOffset;
     }
     
-    // Holds the pointer to the mapped memory pages.
-    _textureData = [NSData dataWithBytesNoCopy:textureDataStart length:totalLength];
+    // Holds the pointer to the mapped memory pages, which the class unmaps when it's freed.
+    _textureData = [NSData dataWithBytesNoCopy:textureDataStart length:totalLength freeWhenDone:NO];
 
     // Process the pixel format.
     return [self readPixelFormat];
@@ -152,7 +159,11 @@ typedef struct
        0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
     };
     
-    _header = (KTXTexHeader*)mappedData;
+    _header       = (KTXTexHeader*)mappedData;
+    _mappedLength = fileInfo.st_size;
+
+    // The sparse texture reads scattered tile rows, so sequential read-ahead only wastes I/O.
+    madvise(mappedData, _mappedLength, MADV_RANDOM);
 
     // Check if the asset file identifier matches the KTX identifier and if the texture format is a 2D texture with at least one mipmap level.
     if ((memcmp(_header->identifier, KTXIdentifier, sizeof(KTXIdentifier)) != 0) ||
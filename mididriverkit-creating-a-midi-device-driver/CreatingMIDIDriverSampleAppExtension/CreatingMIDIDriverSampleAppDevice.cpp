@@ -7,10 +7,12 @@ The implementation of CreatingMIDIDriverSampleAppDevice, a MIDIDriverKit device
 */
 
 #include <MIDIDriverKit/MIDIDriverKit.h>
+#include <DriverKit/IOTimerDispatchSource.h>
 
 #include "CreatingMIDIDriverSampleAppDevice.h"
 #include "CreatingMIDIDriverSampleAppDriver.h"
 #include "CreatingMIDIDriverSampleAppDriverKeys.h"
+#include "CreatingMIDIDriverSampleAppUMPRouter.h"
 
 #include <cstdio>
 
@@ -30,6 +32,20 @@ struct CreatingMIDIDriverSampleAppDevice_IVars
 	OSSharedPtr<IODispatchQueue> mWorkQueue;
 
 	OSSharedPtr<OSArray> mDestinations;
+
+	// One router per entity. Removing an entity destroys its router.
+	CreatingMIDIDriverSampleAppUMPRouter** mRouters;
+	uint32_t mRouterCount;
+	uint32_t mRouterCapacity;
+
+	OSSharedPtr<IOTimerDispatchSource> mFlushTimer;
+	OSSharedPtr<OSAction> mFlushTimerOccurredAction;
+	uint64_t mFlushHostTicks;
+	bool mIsRunning;
+
+	// True while the flush timer has a pending deadline. The I/O blocks arm the timer
+	// only when they leave packets in a router, so an idle device doesn't wake up.
+	std::atomic<bool> mFlushScheduled;
 };
 
 
@@ -54,6 +70,10 @@ bool CreatingMIDIDriverSampleAppDevice::init(
 	ivars->mDriver = OSSharedPtr(driver, OSRetain);
 	ivars->mWorkQueue = GetWorkQueue();
 
+	if (!SetupFlushTimer()) {
+		return false;
+	}
+
 	auto entityName = CreateEntityName(1);
 	auto entity = IOUserMIDIEntity::Create(
 					driver, this, entityName.get(),
@@ -70,6 +90,17 @@ bool CreatingMIDIDriverSampleAppDevice::init(
 void CreatingMIDIDriverSampleAppDevice::free()
 {
 	if (ivars != nullptr) {
+		if (ivars->mFlushTimer) {
+			ivars->mFlushTimer->SetEnable(false);
+		}
+		ivars->mFlushTimer.reset();
+		ivars->mFlushTimerOccurredAction.reset();
+
+		for (uint32_t i = 0; i < ivars->mRouterCount; i++) {
+			CreatingMIDIDriverSampleAppUMPRouter::Destroy(ivars->mRouters[i]);
+		}
+		IOSafeDeleteNULL(ivars->mRouters, CreatingMIDIDriverSampleAppUMPRouter*, ivars->mRouterCapacity);
+
 		ivars->mDriver.reset();
 		ivars->mWorkQueue.reset();
 	}
@@ -90,6 +121,18 @@ kern_return_t CreatingMIDIDriverSampleAppDevice::StartIO()
 		if (error) {
 			DebugMsg("Failed to start I/O, error %d", error);
 			super::StopIO();
+			return;
+		}
+
+		// Start accepting packets. The flush timer has no deadline until a router
+		// holds pending packets.
+		ivars->mIsRunning = true;
+		ivars->mFlushScheduled.store(false);
+		for (uint32_t i = 0; i < ivars->mRouterCount; i++) {
+			ivars->mRouters[i]->Start();
+		}
+		if (ivars->mFlushHostTicks != 0) {
+			ivars->mFlushTimer->SetEnable(true);
 		}
 	});
 
@@ -108,6 +151,14 @@ kern_return_t CreatingMIDIDriverSampleAppDevice::StopIO()
 	__block kern_return_t error;
 
 	ivars->mWorkQueue->DispatchSync(^{
+		// Stop the flush timer. Then stop each router, which rejects any further packets
+		// and forwards the ones still waiting in it.
+		ivars->mIsRunning = false;
+		ivars->mFlushTimer->SetEnable(false);
+		for (uint32_t i = 0; i < ivars->mRouterCount; i++) {
+			ivars->mRouters[i]->Stop();
+		}
+
 		error = super::StopIO();
 	});
 
@@ -129,8 +180,27 @@ void CreatingMIDIDriverSampleAppDevice::SetupEntities()
 		{
 			auto source = entity->GetSource(0);
 			auto destination = entity->GetDestination(0);
+			auto router = GetRouterForSource(source);
+			if (router == nullptr) {
+				// Forward packets without batching so the destination keeps working.
+				DebugMsg("Failed to allocate a UMP router");
+				auto ioBlock = ^kern_return_t(IOUserMIDIUMPWord const* umpWords, size_t numWords) {
+					return source->Send(umpWords, numWords);
+				};
+				destination->SetIOBlock(ioBlock);
+				return false;
+			}
+
+			// Coalesce packets in the router, and forward them right away only
+			// when there's no latency budget. Otherwise, make sure the flush timer
+			// forwards any packets the router holds on to.
+			auto flushNow = (ivars->mFlushHostTicks == 0);
 			auto ioBlock = ^kern_return_t(IOUserMIDIUMPWord const* umpWords, size_t numWords) {
-				return source->Send(umpWords, numWords);
+				auto error = router->Route(umpWords, numWords, flushNow);
+				if (!flushNow && router->GetPendingWordCount() != 0) {
+					ScheduleFlush();
+				}
+				return error;
 			};
 			destination->SetIOBlock(ioBlock);
 		}
@@ -138,6 +208,121 @@ void CreatingMIDIDriverSampleAppDevice::SetupEntities()
 	});
 }
 
+CreatingMIDIDriverSampleAppUMPRouter* CreatingMIDIDriverSampleAppDevice::GetRouterForSource(
+		OSSharedPtr<IOUserMIDISource> source)
+{
+	// Reuse the router for a source that already has one, because its
+	// destination's I/O block may still be running.
+	for (uint32_t i = 0; i < ivars->mRouterCount; i++) {
+		if (ivars->mRouters[i]->IsRoutingTo(source.get())) {
+			return ivars->mRouters[i];
+		}
+	}
+
+	if (ivars->mRouterCount == ivars->mRouterCapacity) {
+		auto capacity = (ivars->mRouterCapacity == 0) ? 4 : ivars->mRouterCapacity * 2;
+		auto routers = IONewZero(CreatingMIDIDriverSampleAppUMPRouter*, capacity);
+		if (routers == nullptr) {
+			return nullptr;
+		}
+		for (uint32_t i = 0; i < ivars->mRouterCount; i++) {
+			routers[i] = ivars->mRouters[i];
+		}
+		IOSafeDeleteNULL(ivars->mRouters, CreatingMIDIDriverSampleAppUMPRouter*, ivars->mRouterCapacity);
+		ivars->mRouters = routers;
+		ivars->mRouterCapacity = capacity;
+	}
+
+	auto router = CreatingMIDIDriverSampleAppUMPRouter::Create(source);
+	if (router == nullptr) {
+		return nullptr;
+	}
+	// An entity added while I/O is running needs its router running too.
+	if (ivars->mIsRunning) {
+		router->Start();
+	}
+	ivars->mRouters[ivars->mRouterCount++] = router;
+	return router;
+}
+
+bool CreatingMIDIDriverSampleAppDevice::SetupFlushTimer()
+{
+	IOTimerDispatchSource* flushTimer = nullptr;
+	OSAction* flushTimerOccurredAction = nullptr;
+	struct mach_timebase_info timebaseInfo;
+
+	// Convert the latency budget to host ticks.
+	mach_timebase_info(&timebaseInfo);
+	ivars->mFlushHostTicks = (kUMPRouterLatencyBudgetNanoseconds * timebaseInfo.denom) / timebaseInfo.numer;
+
+	auto error = IOTimerDispatchSource::Create(ivars->mWorkQueue.get(), &flushTimer);
+	if (error != kIOReturnSuccess) {
+		DebugMsg("Failed to create the flush timer, error %d", error);
+		return false;
+	}
+	ivars->mFlushTimer = OSSharedPtr(flushTimer, OSNoRetain);
+
+	error = CreateActionFlushTimerOccurred(sizeof(void*), &flushTimerOccurredAction);
+	if (error != kIOReturnSuccess) {
+		DebugMsg("Failed to create the flush timer action, error %d", error);
+		return false;
+	}
+	ivars->mFlushTimerOccurredAction = OSSharedPtr(flushTimerOccurredAction, OSNoRetain);
+	ivars->mFlushTimer->SetHandler(ivars->mFlushTimerOccurredAction.get());
+
+	return true;
+}
+
+void CreatingMIDIDriverSampleAppDevice::DestroyRouterForSource(IOUserMIDISource* source)
+{
+	for (uint32_t i = 0; i < ivars->mRouterCount; i++) {
+		if (ivars->mRouters[i]->IsRoutingTo(source)) {
+			// Forward what the router still holds, then release it and its source.
+			ivars->mRouters[i]->Stop();
+			CreatingMIDIDriverSampleAppUMPRouter::Destroy(ivars->mRouters[i]);
+			ivars->mRouters[i] = ivars->mRouters[--ivars->mRouterCount];
+			ivars->mRouters[ivars->mRouterCount] = nullptr;
+			return;
+		}
+	}
+}
+
+void CreatingMIDIDriverSampleAppDevice::ScheduleFlush()
+{
+	// Arm the timer once per latency budget, at the first packet a router holds on to.
+	if (!ivars->mFlushScheduled.exchange(true)) {
+		ivars->mFlushTimer->WakeAtTime(kIOTimerClockMachAbsoluteTime,
+									   mach_absolute_time() + ivars->mFlushHostTicks, 0);
+	}
+}
+
+// Returns true if any router still holds packets after the flush.
+bool CreatingMIDIDriverSampleAppDevice::FlushRouters()
+{
+	bool pending = false;
+	for (uint32_t i = 0; i < ivars->mRouterCount; i++) {
+		ivars->mRouters[i]->Drain();
+		pending |= (ivars->mRouters[i]->GetPendingWordCount() != 0);
+	}
+	return pending;
+}
+
+void CreatingMIDIDriverSampleAppDevice::FlushTimerOccurred_Impl(OSAction* action, uint64_t time)
+{
+	// Clear the flag before draining, so an I/O block that enqueues after the drain
+	// arms the timer again.
+	ivars->mFlushScheduled.store(false);
+
+	if (!ivars->mIsRunning) {
+		return;
+	}
+
+	// Re-arm only if packets arrived during the drain; an idle device stays asleep.
+	if (FlushRouters()) {
+		ScheduleFlush();
+	}
+}
+
 kern_return_t CreatingMIDIDriverSampleAppDevice::PerformDeviceConfigurationChange(
 		uint64_t changeAction, OSObject* changeInfo)
 {
@@ -179,6 +364,16 @@ kern_return_t CreatingMIDIDriverSampleAppDevice::PerformDeviceConfigurationChang
 					auto object = entities->getObject(index);
 					auto entity = OSDynamicCast(IOUserMIDIEntity, object);
 					if (entity != nullptr) {
+						// Keep the source alive until its router is gone, then detach the
+						// destination and destroy the router on the work queue, where the
+						// flush timer also reads the routers.
+						auto source = entity->GetSource(0);
+						entity->GetDestination(0)->SetIOBlock(^kern_return_t(IOUserMIDIUMPWord const*, size_t) {
+							return kIOReturnNotReady;
+						});
+						ivars->mWorkQueue->DispatchSync(^{
+							DestroyRouterForSource(source.get());
+						});
 						RemoveEntity(entity);
 					}
 				} else {
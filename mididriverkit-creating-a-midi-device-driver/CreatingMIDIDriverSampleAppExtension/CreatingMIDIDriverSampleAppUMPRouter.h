@@ -0,0 +1,266 @@
+/*
+See the LICENSE.txt file for this sample’s licensing information.
+
+Abstract:
+The declaration of CreatingMIDIDriverSampleAppUMPRouter, which validates UMP packets
+     from a destination and coalesces them into batches for its source.
+*/
+
+#ifndef CreatingMIDIDriverSampleAppUMPRouter_h
+#define CreatingMIDIDriverSampleAppUMPRouter_h
+
+#include <MIDIDriverKit/MIDIDriverKit.h>
+
+#include <atomic>
+#include <new>
+
+using namespace MIDIDriverKit;
+
+// The number of words the ring buffer between a destination and its source holds.
+// This must be a power of two.
+constexpr size_t kUMPRouterRingWordCount = 1024;
+
+// The largest number of words the router passes to a single `Send` call.
+constexpr size_t kUMPRouterBatchWordCount = 64;
+
+// The longest time a packet waits in the ring before the router forwards it.
+// A budget of zero forwards every batch as soon as it arrives.
+constexpr uint64_t kUMPRouterLatencyBudgetNanoseconds = 1000000;
+
+// The size of a UMP packet in 32-bit words, indexed by its message type,
+// which is the high 4 bits of the packet's first word.
+constexpr uint8_t kUMPWordCountForMessageType[16] = {
+	1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4
+};
+
+// The message types the router forwards. The router drops reserved message types.
+constexpr uint16_t kUMPRouterDefaultMessageTypes =
+	(1 << 0x0) |	// Utility
+	(1 << 0x1) |	// System real time and system common
+	(1 << 0x2) |	// MIDI 1.0 channel voice
+	(1 << 0x3) |	// Data, including system exclusive
+	(1 << 0x4) |	// MIDI 2.0 channel voice
+	(1 << 0x5) |	// Data
+	(1 << 0xD) |	// Flex data
+	(1 << 0xF);		// UMP stream
+
+// Routes UMP packets from one destination's I/O block to one source.
+//
+// The destination's I/O block is the only producer. It validates each packet against
+// the message type table and appends the packets it accepts to a lock-free ring.
+// Whichever thread drains the ring, either the I/O block once a full batch is pending
+// or the device's flush timer once the latency budget expires, sends the pending
+// packets to the source in batches of up to `kUMPRouterBatchWordCount` words.
+//
+// Create routers with `Create` and free them with `Destroy`. A router drops the packets
+// it receives until the device calls `Start`, and again after the device calls `Stop`.
+struct CreatingMIDIDriverSampleAppUMPRouter
+{
+	static CreatingMIDIDriverSampleAppUMPRouter* Create(OSSharedPtr<IOUserMIDISource> source,
+														uint16_t messageTypes = kUMPRouterDefaultMessageTypes)
+	{
+		// IONew only allocates memory, so construct the router in place to initialize
+		// its shared pointer and atomics.
+		auto memory = IONew(CreatingMIDIDriverSampleAppUMPRouter, 1);
+		if (memory == nullptr) {
+			return nullptr;
+		}
+		return new (memory) CreatingMIDIDriverSampleAppUMPRouter(source, messageTypes);
+	}
+
+	static void Destroy(CreatingMIDIDriverSampleAppUMPRouter*& router)
+	{
+		if (router != nullptr) {
+			router->~CreatingMIDIDriverSampleAppUMPRouter();
+			IOSafeDeleteNULL(router, CreatingMIDIDriverSampleAppUMPRouter, 1);
+		}
+	}
+
+	// Starts accepting packets.
+	void Start()
+	{
+		mIsRunning.store(true, std::memory_order_seq_cst);
+	}
+
+	// Stops accepting packets and forwards the ones already in the ring. After this
+	// returns, every packet `Route` accepted has been sent to the source.
+	kern_return_t Stop()
+	{
+		mIsRunning.store(false, std::memory_order_seq_cst);
+
+		// If another thread is draining, this thread's `Drain` returns immediately while
+		// that thread may still be sending. Stopping isn't latency-critical, so wait
+		// until no thread is draining and the ring is empty.
+		kern_return_t error = kIOReturnSuccess;
+		do {
+			auto drainError = Drain();
+			if (drainError != kIOReturnSuccess) {
+				error = drainError;
+			}
+		} while (mDraining.load(std::memory_order_seq_cst) || GetPendingWordCount() != 0);
+
+		return error;
+	}
+
+	// Validates and enqueues the packets in `umpWords`, and forwards them if a full batch
+	// is pending or `flushNow` is true. Call this only from the destination's I/O block.
+	kern_return_t Route(IOUserMIDIUMPWord const* umpWords, size_t numWords, bool flushNow)
+	{
+		if (!mIsRunning.load(std::memory_order_seq_cst)) {
+			mDroppedWordCount.fetch_add(numWords, std::memory_order_relaxed);
+			return kIOReturnNotReady;
+		}
+
+		size_t index = 0;
+		kern_return_t error = kIOReturnSuccess;
+
+		while (index < numWords) {
+			auto messageType = umpWords[index] >> 28;
+			size_t packetWordCount = kUMPWordCountForMessageType[messageType];
+
+			// Drop a truncated packet at the end of the batch, along with anything after it.
+			if (packetWordCount > numWords - index) {
+				mDroppedWordCount.fetch_add(numWords - index, std::memory_order_relaxed);
+				break;
+			}
+
+			if (mMessageTypes & (1 << messageType)) {
+				// If the ring is full, drain it once to make room. If another thread is
+				// already draining, don't wait for it on the I/O thread; drop the packet.
+				if (!Push(&umpWords[index], packetWordCount)) {
+					error = Drain();
+					if (!Push(&umpWords[index], packetWordCount)) {
+						mDroppedWordCount.fetch_add(packetWordCount, std::memory_order_relaxed);
+						error = kIOReturnOverrun;
+					}
+				}
+			} else {
+				mDroppedWordCount.fetch_add(packetWordCount, std::memory_order_relaxed);
+			}
+
+			index += packetWordCount;
+		}
+
+		// If the device stopped while this call was enqueuing, its final drain may have
+		// missed these packets, so forward them here.
+		if (flushNow || GetPendingWordCount() >= kUMPRouterBatchWordCount ||
+			!mIsRunning.load(std::memory_order_seq_cst)) {
+			auto drainError = Drain();
+			if (drainError != kIOReturnSuccess) {
+				error = drainError;
+			}
+		}
+
+		return error;
+	}
+
+	// Sends all pending packets to the source. If another thread is already draining
+	// the ring, this returns immediately and that thread forwards the packets.
+	kern_return_t Drain()
+	{
+		kern_return_t error = kIOReturnSuccess;
+
+		// The producer may push packets after this thread last reads `mHead` but before it
+		// clears `mDraining`. Its own `Drain` call then returns early, so check for packets
+		// again after clearing the flag instead of leaving them for the next `Route` call.
+		// The flag and `mHead` use sequentially consistent operations so that either this
+		// thread sees the new packets or the producer sees the cleared flag.
+		do {
+			if (mDraining.exchange(true, std::memory_order_seq_cst)) {
+				return error;
+			}
+
+			auto tail = mTail.load(std::memory_order_relaxed);
+			auto head = mHead.load(std::memory_order_seq_cst);
+
+			while (tail != head) {
+				size_t batchWordCount = 0;
+
+				// Copy whole packets into the batch until the next packet doesn't fit.
+				while (tail != head) {
+					auto messageType = mRing[tail & (kUMPRouterRingWordCount - 1)] >> 28;
+					size_t packetWordCount = kUMPWordCountForMessageType[messageType];
+
+					if (batchWordCount + packetWordCount > kUMPRouterBatchWordCount) {
+						break;
+					}
+
+					for (size_t i = 0; i < packetWordCount; i++) {
+						mBatch[batchWordCount++] = mRing[(tail + i) & (kUMPRouterRingWordCount - 1)];
+					}
+					tail += packetWordCount;
+				}
+
+				mTail.store(tail, std::memory_order_release);
+
+				auto sendError = mSource->Send(mBatch, batchWordCount);
+				if (sendError != kIOReturnSuccess) {
+					error = sendError;
+				}
+
+				head = mHead.load(std::memory_order_seq_cst);
+			}
+
+			mDraining.store(false, std::memory_order_seq_cst);
+		} while (mHead.load(std::memory_order_seq_cst) != mTail.load(std::memory_order_acquire));
+
+		return error;
+	}
+
+	bool IsRoutingTo(IOUserMIDISource* source) const
+	{
+		return mSource.get() == source;
+	}
+
+	size_t GetPendingWordCount() const
+	{
+		return mHead.load(std::memory_order_acquire) - mTail.load(std::memory_order_acquire);
+	}
+
+	uint64_t GetDroppedWordCount() const
+	{
+		return mDroppedWordCount.load(std::memory_order_relaxed);
+	}
+
+private:
+	CreatingMIDIDriverSampleAppUMPRouter(OSSharedPtr<IOUserMIDISource> source, uint16_t messageTypes)
+		: mSource(source)
+		, mMessageTypes(messageTypes)
+	{
+	}
+
+	~CreatingMIDIDriverSampleAppUMPRouter() = default;
+
+	bool Push(IOUserMIDIUMPWord const* packet, size_t packetWordCount)
+	{
+		auto head = mHead.load(std::memory_order_relaxed);
+		auto tail = mTail.load(std::memory_order_acquire);
+
+		if (head - tail + packetWordCount > kUMPRouterRingWordCount) {
+			return false;
+		}
+
+		for (size_t i = 0; i < packetWordCount; i++) {
+			mRing[(head + i) & (kUMPRouterRingWordCount - 1)] = packet[i];
+		}
+
+		mHead.store(head + packetWordCount, std::memory_order_seq_cst);
+		return true;
+	}
+
+	OSSharedPtr<IOUserMIDISource> mSource;
+	uint16_t mMessageTypes;
+
+	// The producer advances `mHead` and the draining thread advances `mTail`.
+	// Both count words and wrap only when they overflow.
+	std::atomic<size_t> mHead { 0 };
+	std::atomic<size_t> mTail { 0 };
+	std::atomic<bool> mDraining { false };
+	std::atomic<bool> mIsRunning { false };
+	std::atomic<uint64_t> mDroppedWordCount { 0 };
+
+	IOUserMIDIUMPWord mRing[kUMPRouterRingWordCount];
+	IOUserMIDIUMPWord mBatch[kUMPRouterBatchWordCount];
+};
+
+#endif /* CreatingMIDIDriverSampleAppUMPRouter_h */